@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# Decodes debug output of firmware built with LOG_DEFERRED (see src/DeferredLog.h).
+# Text is passed through, binary frames are formatted with the format strings
+# from section .openknx_log of the firmware.elf.
+#
+# usage: Decode-DeferredLog.py firmware.elf [capture.bin | --port COM3 [--baud 115200]]
+# Without capture file and port, data is read from stdin.
+# Reading a serial port needs pyserial, which is part of every PlatformIO installation.
+
+import argparse
+import re
+import struct
+import sys
+
+MARKER = 0x1E
+HEADER_SIZE = 6
+SECTION = b".openknx_log"
+FORMAT_SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diuxXoscfFeEgGp%])")
+
+
+def read_format_strings(elf_path):
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1:
+        sys.exit("%s is not a 32 bit ELF file" % elf_path)
+    sh_off, = struct.unpack_from("<I", elf, 0x20)
+    sh_entsize, sh_num, sh_strndx = struct.unpack_from("<HHH", elf, 0x2E)
+    sections = [struct.unpack_from("<IIIIII", elf, sh_off + i * sh_entsize) for i in range(sh_num)]
+    names_offset = sections[sh_strndx][4]
+    for name, _type, _flags, addr, offset, size in sections:
+        end = elf.index(b"\0", names_offset + name)
+        if elf[names_offset + name:end] != SECTION:
+            continue
+        data = elf[offset:offset + size]
+        strings = {}
+        pos = 0
+        while pos < len(data):
+            end = data.find(b"\0", pos)
+            if end < 0:
+                end = len(data)
+            if end > pos:
+                strings[addr + pos] = data[pos:end].decode("utf-8", "replace")
+            pos = end + 1
+        return strings
+    sys.exit("section %s not found in %s, was the firmware built with LOG_DEFERRED?" % (SECTION.decode(), elf_path))
+
+
+def format_frame(fmt, args):
+    pos = 0
+    result = []
+    last = 0
+    for match in FORMAT_SPEC.finditer(fmt):
+        flags, length, conv = match.groups()
+        result.append(fmt[last:match.start()])
+        last = match.end()
+        if conv == "%":
+            result.append("%")
+            continue
+        try:
+            if conv == "s":
+                size = args[pos]
+                value = args[pos + 1:pos + 1 + size].decode("utf-8", "replace")
+                pos += 1 + size
+            elif conv in "fFeEgG":
+                value, = struct.unpack_from("<f", args, pos)
+                pos += 4
+            else:
+                size = 8 if length == "ll" else 4
+                signed = conv in "di"
+                value = int.from_bytes(args[pos:pos + size], "little", signed=signed)
+                pos += size
+                if conv == "p":
+                    flags, conv, value = "", "s", "0x%08x" % value
+                elif conv == "c":
+                    value = value & 0xFF
+            result.append(("%" + flags + conv) % value)
+        except (IndexError, struct.error, TypeError, ValueError):
+            result.append("<?>")
+    result.append(fmt[last:])
+    return "".join(result)
+
+
+def decode(stream, strings, out):
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            break
+        buffer += chunk
+        while buffer:
+            if buffer[0] != MARKER:
+                end = buffer.find(MARKER)
+                end = len(buffer) if end < 0 else end
+                out.write(buffer[:end].decode("utf-8", "replace"))
+                del buffer[:end]
+                continue
+            if len(buffer) < HEADER_SIZE:
+                break
+            address, size = struct.unpack_from("<IB", buffer, 1)
+            if len(buffer) < HEADER_SIZE + size:
+                break
+            args = bytes(buffer[HEADER_SIZE:HEADER_SIZE + size])
+            del buffer[:HEADER_SIZE + size]
+            fmt = strings.get(address)
+            out.write(format_frame(fmt, args) if fmt is not None else "<unknown format %08X>\n" % address)
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode deferred binary debug output of OpenKNX firmware")
+    parser.add_argument("elf", help="firmware.elf of the running firmware")
+    parser.add_argument("capture", nargs="?", help="file with captured serial output")
+    parser.add_argument("--port", help="serial port to read from")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    strings = read_format_strings(args.elf)
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, args.baud)
+    elif args.capture:
+        stream = open(args.capture, "rb")
+    else:
+        stream = sys.stdin.buffer
+    try:
+        decode(stream, strings, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
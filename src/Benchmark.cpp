@@ -0,0 +1,91 @@
+#include "Benchmark.h"
+#include "Helper.h"
+
+BenchmarkStat Benchmark::flashSave;
+BenchmarkStat Benchmark::flashCommit;
+BenchmarkStat Benchmark::flashRestore;
+BenchmarkStat Benchmark::eepromPageWrite;
+BenchmarkStat Benchmark::eepromRead;
+BenchmarkStat Benchmark::boardCheck;
+BenchmarkStat Benchmark::powerOff;
+BenchmarkStat Benchmark::powerOn;
+BenchmarkStat Benchmark::knxRead;
+
+void BenchmarkStat::add(uint32_t iMicros, uint32_t iBytes /* = 0 */)
+{
+    if (_count == 0 || iMicros < _min)
+        _min = iMicros;
+    if (iMicros > _max)
+        _max = iMicros;
+    _sum += iMicros;
+    _bytes += iBytes;
+    _count++;
+}
+
+void BenchmarkStat::print(const char* iName)
+{
+    if (_count == 0)
+    {
+        printDebug("%-16s no data\n", iName);
+        return;
+    }
+    printDebug("%-16s %5lu x  min %8lu us  avg %8lu us  max %8lu us  %8lu bytes/op\n", iName,
+               (unsigned long)_count, (unsigned long)_min, (unsigned long)(_sum / _count), (unsigned long)_max,
+               (unsigned long)(_bytes / _count));
+}
+
+void BenchmarkStat::reset()
+{
+    _count = 0;
+    _min = 0;
+    _max = 0;
+    _sum = 0;
+    _bytes = 0;
+}
+
+uint32_t BenchmarkStat::count()
+{
+    return _count;
+}
+
+uint32_t BenchmarkStat::average()
+{
+    return _count ? _sum / _count : 0;
+}
+
+uint32_t BenchmarkStat::maximum()
+{
+    return _max;
+}
+
+uint32_t BenchmarkStat::bytes()
+{
+    return _count ? _bytes / _count : 0;
+}
+
+void Benchmark::print()
+{
+    printDebug("Benchmark results:\n");
+    flashSave.print("flash save");
+    flashCommit.print("flash commit");
+    flashRestore.print("flash restore");
+    eepromPageWrite.print("EEPROM page");
+    eepromRead.print("EEPROM read");
+    boardCheck.print("boardCheck");
+    powerOff.print("savePower");
+    powerOn.print("restorePower");
+    knxRead.print("knxRead");
+}
+
+void Benchmark::reset()
+{
+    flashSave.reset();
+    flashCommit.reset();
+    flashRestore.reset();
+    eepromPageWrite.reset();
+    eepromRead.reset();
+    boardCheck.reset();
+    powerOff.reset();
+    powerOn.reset();
+    knxRead.reset();
+}
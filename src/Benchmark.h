@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+
+/*********************************************
+ * Benchmark of persistence and boot
+ * 
+ * Define OPENKNX_BENCHMARK to collect durations
+ * and written bytes of flash saves/restores,
+ * EEPROM page writes and reads, boardCheck(),
+ * savePower()/restorePower() and
+ * OpenKNX::knxRead(). Results
+ * are printed with Benchmark::print().
+ * Without OPENKNX_BENCHMARK everything compiles
+ * to nothing.
+ * On target the real durations are measured.
+ * On the host (pio test -e native_benchmark)
+ * the emulated flash, EEPROM and NCN5130 of
+ * test/stub take the time of the devices.
+ * *******************************************/
+#ifdef OPENKNX_BENCHMARK
+#define BENCHMARK_START(var) uint32_t var = micros()
+#define BENCHMARK_STOP(stat, var, bytes) Benchmark::stat.add(micros() - (var), (bytes))
+#else
+#define BENCHMARK_START(var)
+#define BENCHMARK_STOP(stat, var, bytes)
+#endif
+
+// min/avg/max of durations of one kind of operation
+class BenchmarkStat
+{
+  public:
+    void add(uint32_t iMicros, uint32_t iBytes = 0);
+    void print(const char* iName);
+    void reset();
+    uint32_t count();
+    uint32_t average();
+    uint32_t maximum();
+    // bytes per operation
+    uint32_t bytes();
+
+  private:
+    uint32_t _count = 0;
+    uint32_t _min = 0;
+    uint32_t _max = 0;
+    uint64_t _sum = 0;
+    uint64_t _bytes = 0;
+};
+
+class Benchmark
+{
+  public:
+    static BenchmarkStat flashSave;
+    static BenchmarkStat flashCommit;
+    static BenchmarkStat flashRestore;
+    static BenchmarkStat eepromPageWrite;
+    static BenchmarkStat eepromRead;
+    static BenchmarkStat boardCheck;
+    static BenchmarkStat powerOff;
+    static BenchmarkStat powerOn;
+    static BenchmarkStat knxRead;
+
+    static void print();
+    static void reset();
+};
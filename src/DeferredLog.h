@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+/*********************************************
+ * Deferred binary debug output
+ * 
+ * Define LOG_DEFERRED to let LOG_ERROR, LOG_INFO
+ * and LOG_DEBUG write the address of their format
+ * string and the raw arguments instead of a
+ * formatted text. Formatting is done on the host
+ * by scripts/debug/Decode-DeferredLog.py, which
+ * reads the format strings from the firmware.elf.
+ * 
+ * Format strings are placed in section .openknx_log.
+ * To remove them from flash, declare this section
+ * as not loaded in the linker script:
+ *   .openknx_log 0 (INFO) : { KEEP(*(.openknx_log)) }
+ * 
+ * Frame: DEFERRED_LOG_MARKER, format address (4 bytes),
+ * length of arguments (1 byte), arguments.
+ * Arguments are little endian: integers with 4 bytes
+ * (8 bytes for 64 bit types), floating point as 4 byte
+ * float, strings as length byte followed by the chars.
+ * *******************************************/
+#define DEFERRED_LOG_MARKER 0x1E
+#define DEFERRED_LOG_HEADER_SIZE 6
+#define DEFERRED_LOG_MAX_FRAME 128
+#define DEFERRED_LOG_MAX_STRING 32
+
+#define DEFERRED_LOG_FORMAT(format) ({ static const char lFormat[] __attribute__((section(".openknx_log"), used)) = format; lFormat; })
+
+void pushDebugData(const uint8_t *iData, uint16_t iLength);
+
+inline uint8_t *deferredLogValue(uint8_t *iPos, const uint8_t *iEnd, uint64_t iValue, uint8_t iSize)
+{
+    if (iPos + iSize > iEnd)
+        return iPos;
+    for (uint8_t i = 0; i < iSize; i++)
+        *iPos++ = (uint8_t)(iValue >> (8 * i));
+    return iPos;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint8_t *>::type
+deferredLogArg(uint8_t *iPos, const uint8_t *iEnd, T iValue)
+{
+    return deferredLogValue(iPos, iEnd, (uint64_t)iValue, sizeof(T) > 4 ? 8 : 4);
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, uint8_t *>::type
+deferredLogArg(uint8_t *iPos, const uint8_t *iEnd, T iValue)
+{
+    float lValue = iValue;
+    uint32_t lBits;
+    memcpy(&lBits, &lValue, 4);
+    return deferredLogValue(iPos, iEnd, lBits, 4);
+}
+
+inline uint8_t *deferredLogArg(uint8_t *iPos, const uint8_t *iEnd, const char *iValue)
+{
+    size_t lLength = iValue ? strnlen(iValue, DEFERRED_LOG_MAX_STRING) : 0;
+    if (iPos + 1 + lLength > iEnd)
+        return iPos;
+    *iPos++ = lLength;
+    memcpy(iPos, iValue, lLength);
+    return iPos + lLength;
+}
+
+inline uint8_t *deferredLogArg(uint8_t *iPos, const uint8_t *iEnd, const void *iValue)
+{
+    return deferredLogValue(iPos, iEnd, (uintptr_t)iValue, 4);
+}
+
+inline uint8_t *deferredLogArgs(uint8_t *iPos, const uint8_t * /* iEnd */)
+{
+    return iPos;
+}
+
+template <typename T, typename... Args>
+uint8_t *deferredLogArgs(uint8_t *iPos, const uint8_t *iEnd, T iValue, Args... iArgs)
+{
+    return deferredLogArgs(deferredLogArg(iPos, iEnd, iValue), iEnd, iArgs...);
+}
+
+// costs just a few stores per argument, formatting is done on the host
+template <typename... Args>
+void printDeferred(const char *iFormat, Args... iArgs)
+{
+    uint8_t lFrame[DEFERRED_LOG_MAX_FRAME];
+    uint8_t *lEnd = deferredLogArgs(lFrame + DEFERRED_LOG_HEADER_SIZE, lFrame + DEFERRED_LOG_MAX_FRAME, iArgs...);
+    lFrame[0] = DEFERRED_LOG_MARKER;
+    deferredLogValue(lFrame + 1, lFrame + DEFERRED_LOG_HEADER_SIZE, (uintptr_t)iFormat, 4);
+    lFrame[5] = lEnd - lFrame - DEFERRED_LOG_HEADER_SIZE;
+    pushDebugData(lFrame, lEnd - lFrame);
+}
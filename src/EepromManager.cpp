@@ -1,29 +1,533 @@
 #include <Wire.h>
 #include "HardwareDevices.h"
 #include "EepromManager.h"
+#include "Benchmark.h"
+#include "Helper.h"
+#include "I2cRegistry.h"
 
-EepromManager::EepromManager(uint16_t iStartPage, uint16_t iNumPages, uint8_t *iMagicWord)
+EepromManager::EepromManager(uint16_t iStartPage, uint16_t iNumPages, uint8_t *iMagicWord, bool iDoubleBuffered /* = false */)
 {
     mStartPage = iStartPage;
     mNumPages = iNumPages;
     mMagicWord = iMagicWord;
+    mDoubleBuffered = iDoubleBuffered;
+    layout();
+    registerRegion();
+}
+
+EepromManager::EepromManager(const char *iName, uint8_t *iMagicWord, uint16_t iSize, bool iDoubleBuffered /* = false */)
+{
+    mName = iName;
+    mSize = iSize;
+    mMagicWord = iMagicWord;
+    mDoubleBuffered = iDoubleBuffered;
+    registerRegion();
 }
 
 EepromManager::~EepromManager()
 {
+    delete[] mTouchedPages;
+    for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+        if (sRegions[lIndex] == this)
+        {
+            sRegions[lIndex] = sRegions[--sRegionCount];
+            break;
+        }
+}
+
+EepromManager *EepromManager::sRegions[EEPROM_MAX_REGIONS];
+uint8_t EepromManager::sRegionCount = 0;
+bool EepromManager::sRegionsAllocated = false;
+bool EepromManager::sRegionsOverflow = false;
+
+void EepromManager::registerRegion()
+{
+    // constructors of global instances run before setup(), so errors are reported during allocation
+    if (sRegionCount >= EEPROM_MAX_REGIONS)
+    {
+        sRegionsOverflow = true;
+        return;
+    }
+    sRegions[sRegionCount++] = this;
+    if (sRegionsAllocated && mName == nullptr)
+        checkRegion(this);
+}
+
+void EepromManager::layout()
+{
+    if (mDoubleBuffered)
+    {
+        // both headers get their own device page, slots are multiples of device pages,
+        // so slot addresses keep the alignment of the addresses used by callers
+        const uint16_t lDevicePages = EEPROM_DEVICE_PAGE_SIZE / EEPROM_PAGE_SIZE;
+        mSlotPages = (mNumPages > 2 * lDevicePages) ? (mNumPages - 2 * lDevicePages) / 2 : 0;
+        mSlotPages -= mSlotPages % lDevicePages;
+        delete[] mTouchedPages;
+        mTouchedPages = new uint8_t[(mSlotPages + 7) / 8];
+    }
+}
+
+uint8_t EepromManager::sDirectoryMagicWord[] = {0x4F, 0x4B, 0x44, 0x01};
+
+bool EepromManager::hasNamedRegions()
+{
+    for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+        if (sRegions[lIndex]->mName)
+            return true;
+    return false;
+}
+
+// first region with pages, which overlaps the given pages
+EepromManager *EepromManager::overlappingRegion(uint16_t iStartPage, uint16_t iNumPages, EepromManager *iExclude)
+{
+    for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+    {
+        EepromManager *lOther = sRegions[lIndex];
+        if (lOther == iExclude || lOther->mNumPages == 0)
+            continue;
+        if (iStartPage < lOther->mStartPage + lOther->mNumPages && lOther->mStartPage < iStartPage + iNumPages)
+            return lOther;
+    }
+    return nullptr;
+}
+
+// fatal error, if the region exceeds the EEPROM (or overlaps the allocation directory) or overlaps any other region with pages
+void EepromManager::checkRegion(EepromManager *iRegion)
+{
+    uint16_t lEndPage = hasNamedRegions() ? EEPROM_DIRECTORY_START_PAGE : EEPROM_SIZE / EEPROM_PAGE_SIZE;
+    if (iRegion->mStartPage + iRegion->mNumPages > lEndPage)
+    {
+        printDebug("EEPROM region at page %d (%d pages) exceeds EEPROM, available are %d pages\n", iRegion->mStartPage, iRegion->mNumPages, lEndPage);
+        fatalError(FATAL_EEPROM_REGIONS, "EEPROM region exceeds EEPROM");
+    }
+    EepromManager *lOther = overlappingRegion(iRegion->mStartPage, iRegion->mNumPages, iRegion);
+    if (lOther)
+    {
+        printDebug("EEPROM region at page %d (%d pages) overlaps region at page %d (%d pages)\n",
+                   iRegion->mStartPage, iRegion->mNumPages, lOther->mStartPage, lOther->mNumPages);
+        fatalError(FATAL_EEPROM_REGIONS, "EEPROM regions overlap");
+    }
+}
+
+// first fit: lowest start page, where iNumPages do not overlap any region
+uint16_t EepromManager::findFreePages(uint16_t iNumPages)
+{
+    uint16_t lStartPage = 0;
+    EepromManager *lOther;
+    while ((lOther = overlappingRegion(lStartPage, iNumPages, nullptr)) != nullptr)
+        lStartPage = lOther->mStartPage + lOther->mNumPages;
+    return lStartPage;
+}
+
+// identifies a named region in the allocation directory
+uint16_t EepromManager::nameHash()
+{
+    return crc16((const uint8_t *)mName, strlen(mName));
+}
+
+uint16_t EepromManager::requiredPages()
+{
+    uint16_t lNumPages = (mSize + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE;
+    if (mDoubleBuffered)
+    {
+        const uint16_t lDevicePages = EEPROM_DEVICE_PAGE_SIZE / EEPROM_PAGE_SIZE;
+        lNumPages = 2 * lDevicePages + 2 * ((lNumPages + lDevicePages - 1) / lDevicePages * lDevicePages);
+    }
+    return (lNumPages == 0) ? 1 : lNumPages;
+}
+
+// reads the allocation directory and returns the number of its entries, 0 if there is no valid directory
+uint8_t EepromManager::readDirectory(uint8_t *oDirectory)
+{
+    if (!readDirect(EEPROM_DIRECTORY_START_PAGE * EEPROM_PAGE_SIZE, oDirectory, EEPROM_DIRECTORY_SIZE))
+        return 0;
+    if (memcmp(oDirectory, sDirectoryMagicWord, 4) != 0 || oDirectory[4] > EEPROM_MAX_REGIONS)
+        return 0;
+    uint16_t lLength = 5 + 6 * oDirectory[4];
+    if (crc16(oDirectory, lLength) != ((oDirectory[lLength] << 8) | oDirectory[lLength + 1]))
+        return 0;
+    return oDirectory[4];
+}
+
+// the region gets the pages of its directory entry, if they are still large enough and free
+bool EepromManager::useDirectoryEntry(EepromManager *iRegion, const uint8_t *iDirectory, uint8_t iCount)
+{
+    uint16_t lHash = iRegion->nameHash();
+    for (uint8_t lIndex = 0; lIndex < iCount; lIndex++)
+    {
+        const uint8_t *lEntry = iDirectory + 5 + 6 * lIndex;
+        if (((lEntry[0] << 8) | lEntry[1]) != lHash)
+            continue;
+        uint16_t lStartPage = (lEntry[2] << 8) | lEntry[3];
+        uint16_t lNumPages = (lEntry[4] << 8) | lEntry[5];
+        if (lNumPages < iRegion->requiredPages() || lStartPage + lNumPages > EEPROM_DIRECTORY_START_PAGE ||
+            overlappingRegion(lStartPage, lNumPages, iRegion))
+            return false;
+        iRegion->mStartPage = lStartPage;
+        iRegion->mNumPages = lNumPages;
+        iRegion->layout();
+        return true;
+    }
+    return false;
+}
+
+// writes all named regions to the allocation directory (in order of start pages), if anything changed
+void EepromManager::writeDirectory(const uint8_t *iDirectory)
+{
+    uint8_t lDirectory[EEPROM_DIRECTORY_SIZE];
+    memcpy(lDirectory, sDirectoryMagicWord, 4);
+    uint8_t lCount = 0;
+    int32_t lLastPage = -1;
+    for (;;)
+    {
+        EepromManager *lRegion = nullptr;
+        for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+        {
+            EepromManager *lCandidate = sRegions[lIndex];
+            if (lCandidate->mName && lCandidate->mNumPages > 0 && lCandidate->mStartPage > lLastPage && (!lRegion || lCandidate->mStartPage < lRegion->mStartPage))
+                lRegion = lCandidate;
+        }
+        if (!lRegion)
+            break;
+        uint8_t *lEntry = lDirectory + 5 + 6 * lCount++;
+        uint16_t lHash = lRegion->nameHash();
+        lEntry[0] = lHash >> 8;
+        lEntry[1] = lHash;
+        lEntry[2] = lRegion->mStartPage >> 8;
+        lEntry[3] = lRegion->mStartPage;
+        lEntry[4] = lRegion->mNumPages >> 8;
+        lEntry[5] = lRegion->mNumPages;
+        lLastPage = lRegion->mStartPage;
+    }
+    lDirectory[4] = lCount;
+    uint16_t lLength = 5 + 6 * lCount;
+    uint16_t lCrc = crc16(lDirectory, lLength);
+    lDirectory[lLength] = lCrc >> 8;
+    lDirectory[lLength + 1] = lCrc;
+    if (memcmp(lDirectory, iDirectory, lLength + 2) == 0)
+        return;
+    I2cLock lLock;
+    if (!writeRange(EEPROM_DIRECTORY_START_PAGE * EEPROM_PAGE_SIZE, lDirectory, lLength + 2))
+        LOG_ERROR("EepromManager: write of allocation directory failed\n");
+}
+
+void EepromManager::allocateRegions()
+{
+    if (sRegionsOverflow)
+        fatalError(FATAL_EEPROM_REGIONS, "Too many EEPROM regions");
+    if (!sRegionsAllocated)
+        for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+            if (sRegions[lIndex]->mName == nullptr)
+                checkRegion(sRegions[lIndex]);
+    sRegionsAllocated = true;
+    bool lPending = false;
+    for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+    {
+        EepromManager *lRegion = sRegions[lIndex];
+        if (lRegion->mName == nullptr)
+            continue;
+        lPending = lPending || lRegion->mNumPages == 0;
+        for (uint8_t lOther = lIndex + 1; lOther < sRegionCount; lOther++)
+            if (sRegions[lOther]->mName && sRegions[lOther]->nameHash() == lRegion->nameHash())
+            {
+                printDebug("EEPROM regions %s and %s have the same name hash\n", lRegion->mName, sRegions[lOther]->mName);
+                fatalError(FATAL_EEPROM_REGIONS, "EEPROM regions with same name hash");
+            }
+    }
+    if (!lPending)
+        return;
+    // regions keep their pages of the last allocation
+    uint8_t lDirectory[EEPROM_DIRECTORY_SIZE] = {};
+    uint8_t lCount = readDirectory(lDirectory);
+    for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+        if (sRegions[lIndex]->mName && sRegions[lIndex]->mNumPages == 0)
+            useDirectoryEntry(sRegions[lIndex], lDirectory, lCount);
+    for (;;)
+    {
+        // new and grown regions are allocated in order of their names, so the layout does not depend on construction order
+        EepromManager *lRegion = nullptr;
+        for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+        {
+            EepromManager *lCandidate = sRegions[lIndex];
+            if (lCandidate->mName && lCandidate->mNumPages == 0 && (!lRegion || strcmp(lCandidate->mName, lRegion->mName) < 0))
+                lRegion = lCandidate;
+        }
+        if (!lRegion)
+            break;
+        uint16_t lNumPages = lRegion->requiredPages();
+        lRegion->mStartPage = findFreePages(lNumPages);
+        lRegion->mNumPages = lNumPages;
+        checkRegion(lRegion);
+        lRegion->layout();
+    }
+    // entries of regions, which do not exist anymore, are dropped
+    writeDirectory(lDirectory);
+}
+
+void EepromManager::printRegions()
+{
+    allocateRegions();
+    for (uint8_t lIndex = 0; lIndex < sRegionCount; lIndex++)
+    {
+        EepromManager *lRegion = sRegions[lIndex];
+        printDebug("EEPROM region %s: page %d-%d (%d bytes)%s\n", lRegion->mName ? lRegion->mName : "(fixed)", lRegion->mStartPage,
+                   lRegion->mStartPage + lRegion->mNumPages - 1, lRegion->size(), lRegion->mDoubleBuffered ? " A/B" : "");
+    }
+}
+
+// regions are checked and allocated with first use of any instance, after all instances are constructed
+bool EepromManager::hasRegion()
+{
+    if (!sRegionsAllocated || (mName && mNumPages == 0))
+        allocateRegions();
+    return mNumPages > 0;
+}
+
+uint16_t EepromManager::startAddress()
+{
+    hasRegion();
+    return mStartPage * EEPROM_PAGE_SIZE;
 }
 
 
 uint8_t EepromManager::mFiller[] = {0, 0, 0, 0};
+uint8_t EepromManager::sPageBuffer[EEPROM_WIRE_BUFFER_SIZE - 2];
+bool EepromManager::sSkipUnchanged = EEPROM_SKIP_UNCHANGED;
+SpscQueue<EepromManager::sWriteJob, EEPROM_QUEUE_SIZE> EepromManager::sQueue;
+bool EepromManager::sAsyncResult = true;
+SpscQueue<EepromManager::sCompletion, EEPROM_COMPLETION_QUEUE_SIZE> EepromManager::sCompleted;
+uint16_t EepromManager::sPendingCallbacks = 0;
+volatile bool EepromManager::sWriteCycle = false;
+uint32_t EepromManager::sWriteCycleStart = 0;
+uint8_t EepromManager::sWriteCycleBytes = 0;
+EepromWriteCallback EepromManager::sWriteCycleCallback = nullptr;
+#if EEPROM_CACHE_PAGES > 0
+EepromManager::sCachePage EepromManager::sCache[EEPROM_CACHE_PAGES];
+uint8_t EepromManager::sCacheNext = 0;
+#endif
 
-void EepromManager::beginPage(uint16_t iAddress) {
+// ACK polling: the EEPROM does not acknowledge its address until the internal write cycle is finished.
+// Returns true, if there is no running write cycle anymore.
+bool EepromManager::checkWriteCycle()
+{
 #ifdef I2C_EEPROM_DEVICE_ADDRESSS
-    if (!mIsTransmission)
+    I2cLock lLock;
+    if (sWriteCycle)
     {
         Wire.beginTransmission(I2C_EEPROM_DEVICE_ADDRESSS);
-        Wire.write((uint8_t)((iAddress) >> 8)); // MSB
-        Wire.write((uint8_t)((iAddress)&0xFF)); // LSB
+        if (Wire.endTransmission() != 0 && micros() - sWriteCycleStart < EEPROM_WRITE_DELAY * 1000)
+            return false;
+        sWriteCycle = false;
+        BENCHMARK_STOP(eepromPageWrite, sWriteCycleStart, sWriteCycleBytes);
+        if (sWriteCycleCallback)
+        {
+            EepromWriteCallback lCallback = sWriteCycleCallback;
+            bool lResult = sAsyncResult;
+            sWriteCycleCallback = nullptr;
+            sAsyncResult = true;
+            complete(lCallback, lResult);
+        }
+    }
+#endif
+    return true;
+}
+
+void EepromManager::waitForWriteCycle()
+{
+    while (!checkWriteCycle())
+        ;
+}
+
+void EepromManager::startWriteCycle(uint8_t iBytes, EepromWriteCallback iCallback)
+{
+    sWriteCycle = true;
+    sWriteCycleStart = micros();
+    sWriteCycleBytes = iBytes;
+    sWriteCycleCallback = iCallback;
+}
+
+// Callbacks are never called here, this may run within a synchronous read or write holding I2cLock, or on core 1.
+// They are called by loop(). writeAsync() limits the number of pending callbacks to the size of sCompleted,
+// so the queue is never full and this never blocks.
+void EepromManager::complete(EepromWriteCallback iCallback, bool iResult)
+{
+    sCompleted.push({iCallback, iResult});
+}
+
+// number of bytes, which can be written in one transaction at iAddress
+uint8_t EepromManager::chunkSize(uint16_t iAddress, uint16_t iLength)
+{
+    uint16_t lChunk = EEPROM_DEVICE_PAGE_SIZE - iAddress % EEPROM_DEVICE_PAGE_SIZE;
+    if (lChunk > EEPROM_WIRE_BUFFER_SIZE - 2)
+        lChunk = EEPROM_WIRE_BUFFER_SIZE - 2;
+    if (lChunk > iLength)
+        lChunk = iLength;
+    return lChunk;
+}
+
+// drops all cached pages overlapping the given range
+void EepromManager::invalidateCache(uint16_t iAddress, uint16_t iLength)
+{
+#if EEPROM_CACHE_PAGES > 0
+    for (uint8_t lIndex = 0; lIndex < EEPROM_CACHE_PAGES; lIndex++)
+    {
+        sCachePage &lPage = sCache[lIndex];
+        if (lPage.valid && lPage.address < (uint32_t)iAddress + iLength && iAddress < lPage.address + EEPROM_PAGE_SIZE)
+            lPage.valid = false;
+    }
+#endif
+}
+
+// the EEPROM increments its address counter on each read byte, so after setting the address once
+// all further bytes are read by requestFrom() without address
+bool EepromManager::readDirect(uint16_t iAddress, uint8_t *oData, uint16_t iLength)
+{
+    bool lResult = false;
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    I2cLock lLock;
+    BENCHMARK_START(lStart);
+    waitForWriteCycle();
+    Wire.beginTransmission(I2C_EEPROM_DEVICE_ADDRESSS);
+    Wire.write((uint8_t)((iAddress) >> 8)); // MSB
+    Wire.write((uint8_t)((iAddress)&0xFF)); // LSB
+    lResult = Wire.endTransmission() == 0;
+    for (uint16_t lRemaining = iLength; lResult && lRemaining > 0;)
+    {
+        uint8_t lChunk = (lRemaining > EEPROM_READ_CHUNK_SIZE) ? EEPROM_READ_CHUNK_SIZE : lRemaining;
+        lResult = Wire.requestFrom(I2C_EEPROM_DEVICE_ADDRESSS, lChunk) == lChunk;
+        for (uint8_t lIndex = 0; lResult && lIndex < lChunk; lIndex++)
+            *oData++ = Wire.read();
+        lRemaining -= lChunk;
+    }
+    BENCHMARK_STOP(eepromRead, lStart, iLength);
+#endif
+    return lResult;
+}
+
+bool EepromManager::readCached(uint16_t iAddress, uint8_t *oData, uint16_t iLength)
+{
+#if EEPROM_CACHE_PAGES > 0
+    uint16_t lPageAddress = iAddress - iAddress % EEPROM_PAGE_SIZE;
+    if (iLength == 0 || iAddress + iLength > lPageAddress + EEPROM_PAGE_SIZE)
+        return readDirect(iAddress, oData, iLength);
+    I2cLock lLock;
+    sCachePage *lPage = nullptr;
+    for (uint8_t lIndex = 0; lIndex < EEPROM_CACHE_PAGES && !lPage; lIndex++)
+        if (sCache[lIndex].valid && sCache[lIndex].address == lPageAddress)
+            lPage = &sCache[lIndex];
+    if (!lPage)
+    {
+        lPage = &sCache[sCacheNext];
+        sCacheNext = (sCacheNext + 1) % EEPROM_CACHE_PAGES;
+        lPage->address = lPageAddress;
+        lPage->valid = readDirect(lPageAddress, lPage->data, EEPROM_PAGE_SIZE);
+        if (!lPage->valid)
+            return false;
+    }
+    memcpy(oData, lPage->data + (iAddress - lPageAddress), iLength);
+    return true;
+#else
+    return readDirect(iAddress, oData, iLength);
+#endif
+}
+
+void EepromManager::skipUnchanged(bool iSkip)
+{
+    sSkipUnchanged = iSkip;
+}
+
+// true, if the EEPROM already contains iData, data is read page by page to use the read cache
+bool EepromManager::isUnchanged(uint16_t iAddress, const uint8_t *iData, uint8_t iLength)
+{
+    uint8_t lBuffer[EEPROM_PAGE_SIZE];
+    while (iLength > 0)
+    {
+        uint8_t lChunk = EEPROM_PAGE_SIZE - iAddress % EEPROM_PAGE_SIZE;
+        if (lChunk > iLength)
+            lChunk = iLength;
+        if (!readCached(iAddress, lBuffer, lChunk) || memcmp(lBuffer, iData, lChunk) != 0)
+            return false;
+        iAddress += lChunk;
+        iData += lChunk;
+        iLength -= lChunk;
+    }
+    return true;
+}
+
+// waits for the running write cycle and writes data, which must fit into one transaction
+bool EepromManager::writeChunk(uint16_t iAddress, const uint8_t *iData, uint8_t iLength)
+{
+    bool lResult = false;
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    I2cLock lLock;
+    invalidateCache(iAddress, iLength);
+    waitForWriteCycle();
+    Wire.beginTransmission(I2C_EEPROM_DEVICE_ADDRESSS);
+    Wire.write((uint8_t)((iAddress) >> 8)); // MSB
+    Wire.write((uint8_t)((iAddress)&0xFF)); // LSB
+    Wire.write(iData, iLength);
+    lResult = Wire.endTransmission() == 0;
+#endif
+    return lResult;
+}
+
+// split at device pages and at the Wire buffer limit, the caller holds I2cLock
+bool EepromManager::writeRange(uint16_t iAddress, const uint8_t *iData, uint16_t iLength)
+{
+    bool lResult = true;
+    while (iLength > 0)
+    {
+        uint8_t lChunk = chunkSize(iAddress, iLength);
+        if (!sSkipUnchanged || !isUnchanged(iAddress, iData, lChunk))
+        {
+            lResult = writeChunk(iAddress, iData, lChunk) && lResult;
+            startWriteCycle(lChunk, nullptr);
+        }
+        iAddress += lChunk;
+        iData += lChunk;
+        iLength -= lChunk;
+    }
+    return lResult;
+}
+
+bool EepromManager::read(uint16_t iAddress, uint8_t *oData, uint16_t iLength)
+{
+    if (!hasRegion() || !inRegion(iAddress, iLength))
+        return false;
+    if (mDoubleBuffered)
+    {
+        if (!isValid())
+            return false;
+        iAddress = slotAddress(iAddress, mActiveSlot);
+    }
+    return readCached(iAddress, oData, iLength);
+}
+
+bool EepromManager::write(uint16_t iAddress, const uint8_t *iData, uint16_t iLength)
+{
+    if (!hasRegion())
+        return false;
+    bool lResult = true;
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    // the write cycle has to be started before the other core accesses the EEPROM
+    I2cLock lLock;
+    if (!writeAddress(iAddress, iLength))
+        return false;
+    lResult = writeRange(iAddress, iData, iLength);
+#else
+    lResult = false;
+#endif
+    return lResult;
+}
+
+void EepromManager::beginPage(uint16_t iAddress) {
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    if (!mIsTransmission && hasRegion() && inRegion(iAddress, 0))
+    {
+        // data is collected and written in endPage(), the address is translated there
         mIsTransmission = true;
+        mPageAddress = iAddress;
+        mPageBytes = 0;
     }
 #endif
 }
@@ -34,8 +538,17 @@ bool EepromManager::endPage() {
     if (mIsTransmission)
     {
         mIsTransmission = false;
-        lResult = Wire.endTransmission() == 0;
-        delay(EEPROM_WRITE_DELAY);
+        if (mPageBytes > sizeof(sPageBuffer))
+            return false;
+        I2cLock lLock;
+        uint16_t lAddress = mPageAddress;
+        if (!writeAddress(lAddress, mPageBytes))
+            return false;
+        if (sSkipUnchanged && isUnchanged(lAddress, sPageBuffer, mPageBytes))
+            return true;
+        lResult = writeChunk(lAddress, sPageBuffer, mPageBytes);
+        // there is no delay for the write cycle, the next access to EEPROM waits for its end
+        startWriteCycle(mPageBytes, nullptr);
     }
 #endif
     return lResult;
@@ -43,14 +556,25 @@ bool EepromManager::endPage() {
 
 void EepromManager::write4Bytes(uint8_t* iData, uint8_t iLen) {
 #ifdef I2C_EEPROM_DEVICE_ADDRESSS
-    Wire.write(iData, iLen);
-    if (iLen < 4)
-        Wire.write(mFiller, 4 - iLen);
+    uint8_t lLen = (iLen < 4) ? 4 : iLen;
+    if (mPageBytes + lLen <= sizeof(sPageBuffer))
+    {
+        memcpy(sPageBuffer + mPageBytes, iData, iLen);
+        if (iLen < 4)
+            memcpy(sPageBuffer + mPageBytes + iLen, mFiller, 4 - iLen);
+    }
+    mPageBytes += lLen;
 #endif
 }
 
 void EepromManager::prepareRead(uint16_t iAddress, uint8_t iLen) {
 #ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    if (!hasRegion() || !inRegion(iAddress, iLen))
+        return;
+    if (mDoubleBuffered)
+        iAddress = slotAddress(iAddress, isValid() ? mActiveSlot : 0);
+    I2cLock lLock;
+    waitForWriteCycle();
     Wire.beginTransmission(I2C_EEPROM_DEVICE_ADDRESSS);
     Wire.write((uint8_t)((iAddress) >> 8)); // MSB
     Wire.write((uint8_t)((iAddress)&0xFF)); // LSB
@@ -62,10 +586,8 @@ void EepromManager::prepareRead(uint16_t iAddress, uint8_t iLen) {
 bool EepromManager::checkMagicWord(uint16_t iAddress) {
     bool lResult = true;
 #ifdef I2C_EEPROM_DEVICE_ADDRESSS
-    prepareRead(iAddress, 4);
-    int lIndex = 0;
-    while (lResult && lIndex < 4) 
-        lResult = Wire.available() && (mMagicWord[lIndex++] == Wire.read());
+    uint8_t lMagicWord[4];
+    lResult = hasRegion() && inRegion(iAddress, 4) && readCached(iAddress, lMagicWord, 4) && memcmp(lMagicWord, mMagicWord, 4) == 0;
 #else
     lResult = false;
 #endif
@@ -83,17 +605,233 @@ bool EepromManager::writeSession(bool iBegin) {
 }
 
 bool EepromManager::beginWriteSession() {
+    if (!hasRegion())
+        return false;
+    if (mDoubleBuffered)
+    {
+        // the active slot is not touched, it stays valid until the new one is committed
+        mWriteSlot = isValid() ? 1 - mActiveSlot : 0;
+        mSessionLength = 0;
+        if (mSlotPages > 0)
+            memset(mTouchedPages, 0, (mSlotPages + 7) / 8);
+        return mSlotPages > 0;
+    }
     return writeSession(true);
 }
 
 void EepromManager::endWriteSession() {
+    if (mDoubleBuffered)
+    {
+        if (!commitSlot())
+            LOG_ERROR("EepromManager: Commit of slot %d failed\n", mWriteSlot);
+        return;
+    }
     // as a last step we write magic number back
     // this is also the ACK, that writing was successfull
     writeSession(false);
 }
 
+uint16_t EepromManager::size()
+{
+    hasRegion();
+    return (mDoubleBuffered ? mSlotPages : mNumPages) * EEPROM_PAGE_SIZE;
+}
+
+uint16_t EepromManager::slotHeaderAddress(uint8_t iSlot)
+{
+    return mStartPage * EEPROM_PAGE_SIZE + iSlot * EEPROM_DEVICE_PAGE_SIZE;
+}
+
+// translates an address of the region to the same address in slot iSlot
+uint16_t EepromManager::slotAddress(uint16_t iAddress, uint8_t iSlot)
+{
+    return iAddress + 2 * EEPROM_DEVICE_PAGE_SIZE + iSlot * mSlotPages * EEPROM_PAGE_SIZE;
+}
+
+// true, if iLength bytes at iAddress are within size() bytes of the region
+bool EepromManager::inRegion(uint16_t iAddress, uint16_t iLength)
+{
+    uint16_t lStart = mStartPage * EEPROM_PAGE_SIZE;
+    return iAddress >= lStart && (uint32_t)iAddress + iLength <= (uint32_t)lStart + size();
+}
+
+// Checks a write against the region and translates its address in double buffered mode.
+// The first partial write to a page of a session copies the page from the active slot before,
+// so the image does not contain stale bytes of an older session.
+bool EepromManager::writeAddress(uint16_t &ioAddress, uint16_t iLength)
+{
+    if (!inRegion(ioAddress, iLength))
+    {
+        LOG_ERROR("EepromManager: write of %d bytes at %d exceeds region\n", iLength, ioAddress);
+        return false;
+    }
+    if (!mDoubleBuffered)
+        return true;
+    uint16_t lOffset = ioAddress - mStartPage * EEPROM_PAGE_SIZE;
+    uint16_t lEnd = lOffset + iLength;
+    for (uint16_t lPage = lOffset / EEPROM_PAGE_SIZE; lPage * EEPROM_PAGE_SIZE < lEnd; lPage++)
+    {
+        if (mTouchedPages[lPage / 8] & (1 << (lPage % 8)))
+            continue;
+        bool lPartial = lOffset > lPage * EEPROM_PAGE_SIZE || lEnd < (lPage + 1) * EEPROM_PAGE_SIZE;
+        if (lPartial && !copyPage(lPage))
+            return false;
+        mTouchedPages[lPage / 8] |= 1 << (lPage % 8);
+    }
+    if (lEnd > mSessionLength)
+        mSessionLength = lEnd;
+    ioAddress = slotAddress(ioAddress, mWriteSlot);
+    return true;
+}
+
+// copies a page of the image from the active slot to the session slot, if the active slot contains it
+bool EepromManager::copyPage(uint16_t iPage)
+{
+    uint16_t lOffset = iPage * EEPROM_PAGE_SIZE;
+    if (!isValid() || mWriteSlot == mActiveSlot || lOffset >= mActiveLength)
+        return true;
+    uint8_t lBuffer[EEPROM_PAGE_SIZE];
+    uint16_t lAddress = mStartPage * EEPROM_PAGE_SIZE + lOffset;
+    I2cLock lLock;
+    if (!readDirect(slotAddress(lAddress, mActiveSlot), lBuffer, EEPROM_PAGE_SIZE))
+        return false;
+    bool lResult = writeChunk(slotAddress(lAddress, mWriteSlot), lBuffer, EEPROM_PAGE_SIZE);
+    startWriteCycle(EEPROM_PAGE_SIZE, nullptr);
+    return lResult;
+}
+
+// pages of the active image, which were not written by the session, are taken from the active slot
+bool EepromManager::copyUntouchedPages()
+{
+    if (!isValid() || mWriteSlot == mActiveSlot)
+        return true;
+    for (uint16_t lPage = 0; lPage * EEPROM_PAGE_SIZE < mActiveLength; lPage++)
+    {
+        if (mTouchedPages[lPage / 8] & (1 << (lPage % 8)))
+            continue;
+        if (!copyPage(lPage))
+            return false;
+        mTouchedPages[lPage / 8] |= 1 << (lPage % 8);
+    }
+    if (mActiveLength > mSessionLength)
+        mSessionLength = mActiveLength;
+    return true;
+}
+
+bool EepromManager::readSlotHeader(uint8_t iSlot, uint32_t &oGeneration, uint16_t &oLength, uint16_t &oCrc)
+{
+    uint8_t lHeader[EEPROM_SLOT_HEADER_SIZE];
+    if (!readDirect(slotHeaderAddress(iSlot), lHeader, EEPROM_SLOT_HEADER_SIZE))
+        return false;
+    if (memcmp(lHeader, mMagicWord, 4) != 0)
+        return false;
+    if (crc16(lHeader, EEPROM_SLOT_HEADER_SIZE - 2) != ((lHeader[12] << 8) | lHeader[13]))
+        return false;
+    oGeneration = ((uint32_t)lHeader[4] << 24) | ((uint32_t)lHeader[5] << 16) | ((uint32_t)lHeader[6] << 8) | lHeader[7];
+    oLength = (lHeader[8] << 8) | lHeader[9];
+    oCrc = (lHeader[10] << 8) | lHeader[11];
+    return oLength <= mSlotPages * EEPROM_PAGE_SIZE;
+}
+
+// CRC of the first iLength bytes of the data of iSlot
+bool EepromManager::slotCrc(uint8_t iSlot, uint16_t iLength, uint16_t &oCrc)
+{
+    uint8_t lBuffer[EEPROM_PAGE_SIZE];
+    uint16_t lAddress = slotAddress(mStartPage * EEPROM_PAGE_SIZE, iSlot);
+    oCrc = 0xFFFF;
+    while (iLength > 0)
+    {
+        uint16_t lChunk = (iLength > EEPROM_PAGE_SIZE) ? EEPROM_PAGE_SIZE : iLength;
+        if (!readDirect(lAddress, lBuffer, lChunk))
+            return false;
+        oCrc = crc16(lBuffer, lChunk, oCrc);
+        lAddress += lChunk;
+        iLength -= lChunk;
+    }
+    return true;
+}
+
+// writes the header of the session slot, which makes it the active slot
+bool EepromManager::commitSlot()
+{
+    if (mSlotPages == 0)
+        return false;
+    // Queued asynchronous writes of this session have to be written before. They are written here, core 1
+    // does not write during setup() and waits for the I2C lock held by core 0 otherwise. Their callbacks are
+    // called by the next loop().
+    while (!idle())
+        process();
+    if (!copyUntouchedPages())
+        return false;
+    uint16_t lCrc;
+    if (!slotCrc(mWriteSlot, mSessionLength, lCrc))
+        return false;
+    uint32_t lGeneration = mGeneration + 1;
+    uint8_t lHeader[EEPROM_SLOT_HEADER_SIZE];
+    memcpy(lHeader, mMagicWord, 4);
+    lHeader[4] = lGeneration >> 24;
+    lHeader[5] = lGeneration >> 16;
+    lHeader[6] = lGeneration >> 8;
+    lHeader[7] = lGeneration;
+    lHeader[8] = mSessionLength >> 8;
+    lHeader[9] = mSessionLength;
+    lHeader[10] = lCrc >> 8;
+    lHeader[11] = lCrc;
+    uint16_t lHeaderCrc = crc16(lHeader, EEPROM_SLOT_HEADER_SIZE - 2);
+    lHeader[12] = lHeaderCrc >> 8;
+    lHeader[13] = lHeaderCrc;
+    I2cLock lLock;
+    bool lResult = writeChunk(slotHeaderAddress(mWriteSlot), lHeader, EEPROM_SLOT_HEADER_SIZE);
+    startWriteCycle(EEPROM_SLOT_HEADER_SIZE, nullptr);
+    if (lResult)
+    {
+        mGeneration = lGeneration;
+        mActiveSlot = mWriteSlot;
+        mActiveLength = mSessionLength;
+        mIsValidEEPROM = true;
+        mValidityChecked = true;
+    }
+    return lResult;
+}
+
+// the newest slot with valid header and data is the active one, an interrupted session falls back to the other slot
+bool EepromManager::checkSlotsValid()
+{
+    uint32_t lGeneration[2] = {0, 0};
+    uint16_t lLength[2] = {0, 0};
+    uint16_t lCrc[2];
+    bool lValid[2];
+    for (uint8_t lSlot = 0; lSlot < 2; lSlot++)
+        lValid[lSlot] = mSlotPages > 0 && readSlotHeader(lSlot, lGeneration[lSlot], lLength[lSlot], lCrc[lSlot]);
+    uint8_t lFirst = (lValid[1] && (!lValid[0] || (int32_t)(lGeneration[1] - lGeneration[0]) > 0)) ? 1 : 0;
+    for (uint8_t lIndex = 0; lIndex < 2; lIndex++)
+    {
+        uint8_t lSlot = lIndex ? 1 - lFirst : lFirst;
+        uint16_t lDataCrc;
+        if (lValid[lSlot] && slotCrc(lSlot, lLength[lSlot], lDataCrc) && lDataCrc == lCrc[lSlot])
+        {
+            mActiveSlot = lSlot;
+            mGeneration = lGeneration[lSlot];
+            mActiveLength = lLength[lSlot];
+            return true;
+        }
+    }
+    return false;
+}
 
 bool EepromManager::checkDataValid() {
+    if (!hasRegion())
+    {
+        mIsValidEEPROM = false;
+        mValidityChecked = true;
+        return false;
+    }
+    if (mDoubleBuffered)
+    {
+        mIsValidEEPROM = checkSlotsValid();
+        mValidityChecked = true;
+        return mIsValidEEPROM;
+    }
     uint16_t lAddress = mStartPage * 32 + 12;
     mIsValidEEPROM = checkMagicWord(lAddress);
     mValidityChecked = true;
@@ -105,3 +843,101 @@ bool EepromManager::isValid() {
     return mIsValidEEPROM;
 }
 
+bool EepromManager::writeAsync(uint16_t iAddress, const uint8_t *iData, uint16_t iLength, EepromWriteCallback iCallback /* = nullptr */)
+{
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+#ifdef OPENKNX_DUALCORE
+    // sQueue has a single producer, sPendingCallbacks is not shared either
+    if (rp2040.cpuid() != 0)
+    {
+        LOG_ERROR("EepromManager: writeAsync() called on core 1\n");
+        return false;
+    }
+#endif
+    if (!hasRegion())
+        return false;
+    // each job is written in one transaction, slots keep the alignment to device pages, so the number
+    // of jobs does not depend on address translation
+    uint16_t lJobs = 0;
+    for (uint16_t lAddress = iAddress, lLength = iLength; lLength > 0; lJobs++)
+    {
+        uint8_t lChunk = chunkSize(lAddress, lLength);
+        if (lChunk > EEPROM_PAGE_SIZE)
+            lChunk = EEPROM_PAGE_SIZE;
+        lAddress += lChunk;
+        lLength -= lChunk;
+    }
+    if (lJobs == 0 || sQueue.free() < lJobs || (iCallback && sPendingCallbacks >= EEPROM_COMPLETION_QUEUE_SIZE) || !writeAddress(iAddress, iLength))
+        return false;
+    if (iCallback)
+        sPendingCallbacks++;
+    while (iLength > 0)
+    {
+        sWriteJob lJob;
+        lJob.address = iAddress;
+        lJob.length = chunkSize(iAddress, iLength);
+        if (lJob.length > EEPROM_PAGE_SIZE)
+            lJob.length = EEPROM_PAGE_SIZE;
+        memcpy(lJob.data, iData, lJob.length);
+        iAddress += lJob.length;
+        iData += lJob.length;
+        iLength -= lJob.length;
+        lJob.callback = (iLength == 0) ? iCallback : nullptr;
+        // free space was checked above and the consumer just frees space, so this fails just on a logic error
+        if (!sQueue.push(lJob))
+            return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool EepromManager::idle()
+{
+    return sQueue.empty() && !sWriteCycle;
+}
+
+// Each call writes at most one page and returns immediately, if the EEPROM is still busy.
+// The page is taken from queue within the lock, so idle() is not true before its write cycle started,
+// and process() can be called on both cores (i.e. by commitSlot() on core 0).
+void EepromManager::process()
+{
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    // without pending work core 1 does not wait for the lock
+    if (idle())
+        return;
+    I2cLock lLock;
+    sWriteJob lJob;
+    if (!checkWriteCycle() || !sQueue.pop(lJob))
+        return;
+    if (sSkipUnchanged && isUnchanged(lJob.address, lJob.data, lJob.length))
+    {
+        if (lJob.callback)
+        {
+            bool lResult = sAsyncResult;
+            sAsyncResult = true;
+            complete(lJob.callback, lResult);
+        }
+        return;
+    }
+    bool lResult = writeChunk(lJob.address, lJob.data, lJob.length);
+    // just results of queued pages are collected for the callback, synchronous writes return their own result
+    sAsyncResult = sAsyncResult && lResult;
+    startWriteCycle(lJob.length, lJob.callback);
+#endif
+}
+
+void EepromManager::loop()
+{
+#ifndef OPENKNX_DUALCORE
+    process();
+#endif
+    // callbacks are called here only, without I2cLock, so they may use the synchronous API
+    sCompletion lCompletion;
+    while (sCompleted.pop(lCompletion))
+    {
+        sPendingCallbacks--;
+        lCompletion.callback(lCompletion.result);
+    }
+}
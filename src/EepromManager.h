@@ -4,34 +4,236 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <Arduino.h>
+// EEPROM_WIRE_BUFFER_SIZE depends on WIRE_BUFFER_SIZE, so it has to be the same in all translation units
+#include <Wire.h>
+#include "SpscQueue.h"
 /*********************************************
  * Manage a part of EEPROM for persisted data
  * 
  * Create a class providing statring point and
- * size information. Different instances will
- * also prevent overlap
+ * size information or just a name and size.
+ * Named regions are allocated the first time
+ * an instance is used (or by allocateRegions()).
+ * Their pages are stored in an allocation
+ * directory at the end of the EEPROM, so a
+ * region keeps its pages in later firmware
+ * versions, as long as it does not grow. New
+ * or grown regions get the first free pages.
+ * Overlapping regions are a fatal error,
+ * checked at the same time. Accesses outside
+ * of the region of an instance are rejected.
+ * 
+ * Double buffered (A/B) mode: the region holds
+ * two slots with a header each (magic word,
+ * generation, length and CRC of data). A write
+ * session writes to the inactive slot and is
+ * committed by writing its header, so an
+ * interrupted session keeps the last image.
+ * Reads always use the active slot. Addresses
+ * are the same as in single buffered mode
+ * (mStartPage * EEPROM_PAGE_SIZE + offset). Pages
+ * not written by a session are copied from the
+ * active slot, so a session can write just the
+ * changed parts of the image.
+ *
+ * Callbacks of asynchronous writes are always
+ * called by loop(), never within another call.
+ *
+ * Dual core mode (OPENKNX_DUALCORE): queued
+ * pages are written by process() on core 1,
+ * callbacks are passed back and called by
+ * loop() on core 0. commitSlot() writes the
+ * remaining pages itself. All I2C access is done
+ * with I2cLock. prepareRead() leaves the data
+ * in the Wire buffer outside of the lock, so
+ * use read() instead in this mode.
  * *******************************************/
-// During EEPROM Write we have to delay 5 ms
+// Maximum duration of the internal EEPROM write cycle in ms. The end of the write cycle
+// is detected by ACK polling, this is just the timeout.
 #define EEPROM_WRITE_DELAY 5
+// size of a page as used by EepromManager (start page and number of pages of an instance)
+#define EEPROM_PAGE_SIZE 32
+// size of a physical page of the EEPROM (24LC256), a single write must not cross its boundary
+#ifndef EEPROM_DEVICE_PAGE_SIZE
+#define EEPROM_DEVICE_PAGE_SIZE 64
+#endif
+// size of the Wire transmit buffer, each transmission needs 2 bytes for the address
+#ifndef EEPROM_WIRE_BUFFER_SIZE
+#ifdef WIRE_BUFFER_SIZE
+#define EEPROM_WIRE_BUFFER_SIZE WIRE_BUFFER_SIZE
+#else
+#define EEPROM_WIRE_BUFFER_SIZE (EEPROM_PAGE_SIZE + 2)
+#endif
+#endif
+// size of the EEPROM in bytes (24LC256)
+#ifndef EEPROM_SIZE
+#define EEPROM_SIZE 32768
+#endif
+// maximum number of EepromManager instances
+#ifndef EEPROM_MAX_REGIONS
+#define EEPROM_MAX_REGIONS 8
+#endif
+// maximum number of bytes of one read transaction (requestFrom), bytes are read sequentially in chunks of this size
+#ifndef EEPROM_READ_CHUNK_SIZE
+#if EEPROM_WIRE_BUFFER_SIZE > 255
+#define EEPROM_READ_CHUNK_SIZE 255
+#else
+#define EEPROM_READ_CHUNK_SIZE EEPROM_WIRE_BUFFER_SIZE
+#endif
+#endif
+// size of the allocation directory of named regions at the end of the EEPROM:
+// magic word, number of entries, entries (hash of name, start page, number of pages), CRC
+#define EEPROM_DIRECTORY_SIZE (4 + 1 + 6 * EEPROM_MAX_REGIONS + 2)
+#define EEPROM_DIRECTORY_PAGES ((EEPROM_DIRECTORY_SIZE + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE)
+#define EEPROM_DIRECTORY_START_PAGE (EEPROM_SIZE / EEPROM_PAGE_SIZE - EEPROM_DIRECTORY_PAGES)
+// number of pages (EEPROM_PAGE_SIZE) kept in RAM for repeated reads, 0 disables the read cache
+#ifndef EEPROM_CACHE_PAGES
+#define EEPROM_CACHE_PAGES 4
+#endif
+// default of skipUnchanged(): with 1, data is read back before each write and unchanged data is not written.
+// This costs a read per page, but saves the write cycle and wear of each unchanged page.
+#ifndef EEPROM_SKIP_UNCHANGED
+#define EEPROM_SKIP_UNCHANGED 0
+#endif
+// size of the header of a slot in double buffered mode:
+// magic word, generation, length of data, CRC of data, CRC of header
+#define EEPROM_SLOT_HEADER_SIZE 14
+// number of pages, which can be queued for asynchronous write (power of two)
+#ifndef EEPROM_QUEUE_SIZE
+#define EEPROM_QUEUE_SIZE 8
+#endif
+// maximum number of asynchronous writes with callback, which are queued or wait for loop() (power of two)
+#ifndef EEPROM_COMPLETION_QUEUE_SIZE
+#define EEPROM_COMPLETION_QUEUE_SIZE (2 * EEPROM_QUEUE_SIZE)
+#endif
+
+// called, when all pages of an asynchronous write are written
+typedef void (*EepromWriteCallback)(bool iSuccess);
 
 class EepromManager
 {
   private:
+    struct sWriteJob
+    {
+        uint16_t address;
+        uint8_t length;
+        uint8_t data[EEPROM_PAGE_SIZE];
+        EepromWriteCallback callback; // just set for the last page of a write
+    };
+
+    struct sCompletion
+    {
+        EepromWriteCallback callback;
+        bool result;
+    };
+
+    struct sCachePage
+    {
+        uint16_t address;
+        bool valid;
+        uint8_t data[EEPROM_PAGE_SIZE];
+    };
+
     static uint8_t mFiller[];
+    static uint8_t sDirectoryMagicWord[];
+    // all instances, used for allocation and overlap check
+    static EepromManager *sRegions[EEPROM_MAX_REGIONS];
+    static uint8_t sRegionCount;
+    static bool sRegionsAllocated;
+    static bool sRegionsOverflow;
+    // data of the page API is collected here, because there is just one open transmission at a time
+    static uint8_t sPageBuffer[EEPROM_WIRE_BUFFER_SIZE - 2];
+    static bool sSkipUnchanged;
+#if EEPROM_CACHE_PAGES > 0
+    // read cache, shared by all instances, replaced round robin
+    static sCachePage sCache[EEPROM_CACHE_PAGES];
+    static uint8_t sCacheNext;
+#endif
+    // asynchronous write queue, shared by all instances, because there is just one EEPROM.
+    // Producer is writeAsync(), consumer is process(), which pops just with I2cLock, so it may run on both cores.
+    static SpscQueue<sWriteJob, EEPROM_QUEUE_SIZE> sQueue;
+    static bool sAsyncResult; // collected result of the pages of the current asynchronous write
+    // finished asynchronous writes, producers hold I2cLock, consumer is loop()
+    static SpscQueue<sCompletion, EEPROM_COMPLETION_QUEUE_SIZE> sCompleted;
+    // asynchronous writes with callback, which are queued or not completed by loop() yet (just used on core 0)
+    static uint16_t sPendingCallbacks;
+    // state of the internal write cycle of the EEPROM
+    static volatile bool sWriteCycle;
+    static uint32_t sWriteCycleStart;
+    static uint8_t sWriteCycleBytes;
+    static EepromWriteCallback sWriteCycleCallback;
+
+    static bool checkWriteCycle();
+    static void waitForWriteCycle();
+    static void startWriteCycle(uint8_t iBytes, EepromWriteCallback iCallback);
+    static void complete(EepromWriteCallback iCallback, bool iResult);
+    static bool writeChunk(uint16_t iAddress, const uint8_t *iData, uint8_t iLength);
+    static uint8_t chunkSize(uint16_t iAddress, uint16_t iLength);
+    static bool readDirect(uint16_t iAddress, uint8_t *oData, uint16_t iLength);
+    static bool readCached(uint16_t iAddress, uint8_t *oData, uint16_t iLength);
+    static bool isUnchanged(uint16_t iAddress, const uint8_t *iData, uint8_t iLength);
+    static void invalidateCache(uint16_t iAddress, uint16_t iLength);
+    static bool writeRange(uint16_t iAddress, const uint8_t *iData, uint16_t iLength);
+    static bool hasNamedRegions();
+    static EepromManager *overlappingRegion(uint16_t iStartPage, uint16_t iNumPages, EepromManager *iExclude);
+    static void checkRegion(EepromManager *iRegion);
+    static uint16_t findFreePages(uint16_t iNumPages);
+    static uint8_t readDirectory(uint8_t *oDirectory);
+    static void writeDirectory(const uint8_t *iDirectory);
+    static bool useDirectoryEntry(EepromManager *iRegion, const uint8_t *iDirectory, uint8_t iCount);
+
+    uint16_t nameHash();
+    uint16_t requiredPages();
+
     bool mIsTransmission = false;
+    uint16_t mPageAddress = 0;
+    uint16_t mPageBytes = 0;
     bool mValidityChecked = false;
     bool mIsValidEEPROM = false;
     uint16_t mStartPage = 0;
     uint16_t mNumPages = 0;
     uint8_t* mMagicWord = 0;
+    const char* mName = nullptr; // just set for allocated regions
+    uint16_t mSize = 0;          // requested size of allocated regions
+    // double buffered mode
+    bool mDoubleBuffered = false;
+    uint16_t mSlotPages = 0;
+    uint8_t mActiveSlot = 0;
+    uint8_t mWriteSlot = 0;
+    uint32_t mGeneration = 0;
+    uint16_t mSessionLength = 0;
+    uint16_t mActiveLength = 0;
+    uint8_t *mTouchedPages = nullptr; // bitmap of pages written in current session
 
+    void registerRegion();
+    void layout();
+    bool hasRegion();
     bool writeSession(bool iBegin);
     bool checkDataValid();
+    bool checkSlotsValid();
+    bool commitSlot();
+    uint16_t slotHeaderAddress(uint8_t iSlot);
+    uint16_t slotAddress(uint16_t iAddress, uint8_t iSlot);
+    bool inRegion(uint16_t iAddress, uint16_t iLength);
+    bool writeAddress(uint16_t &ioAddress, uint16_t iLength);
+    bool copyPage(uint16_t iPage);
+    bool copyUntouchedPages();
+    bool readSlotHeader(uint8_t iSlot, uint32_t &oGeneration, uint16_t &oLength, uint16_t &oCrc);
+    bool slotCrc(uint8_t iSlot, uint16_t iLength, uint16_t &oCrc);
 
   public:
-    EepromManager(uint16_t iStartPage, uint16_t iNumPages, uint8_t *iMagicWord);
+    EepromManager(uint16_t iStartPage, uint16_t iNumPages, uint8_t *iMagicWord, bool iDoubleBuffered = false);
+    // region of iSize usable bytes is allocated by the central allocator (in double buffered mode per slot)
+    EepromManager(const char *iName, uint8_t *iMagicWord, uint16_t iSize, bool iDoubleBuffered = false);
     ~EepromManager();
 
+    // checks all regions and allocates all named regions, which are not allocated yet
+    static void allocateRegions();
+    // prints the allocated regions
+    static void printRegions();
+    // first address of the region, addresses used with this instance are relative to EEPROM start
+    uint16_t startAddress();
+
     bool beginWriteSession();
     void endWriteSession();
     void beginPage(uint16_t iAddress);
@@ -40,6 +242,31 @@ class EepromManager
     void prepareRead(uint16_t iAddress, uint8_t iLen);
     bool checkMagicWord(uint16_t iAddress);
     bool isValid();
+    // number of bytes usable for data (in double buffered mode the size of one slot)
+    uint16_t size();
+
+    // Write data of any length. It is split at page boundaries and at the Wire buffer limit, so each
+    // transaction writes as many bytes as possible. Does not wait for the last write cycle to finish.
+    bool write(uint16_t iAddress, const uint8_t *iData, uint16_t iLength);
+    // Read data of any length with one addressed transaction followed by sequential reads of maximum size.
+    // Reads within one page are served from (and fill) the read cache.
+    bool read(uint16_t iAddress, uint8_t *oData, uint16_t iLength);
+    // Queue data for asynchronous write, it is written page by page from loop() without blocking.
+    // Data is copied. iCallback (optional) is called after the last page is written. Call this on core 0 only
+    // (not in tasks of ioScheduler() with OPENKNX_DUALCORE), there is a single producer for the queue.
+    // Returns false (and queues nothing), if there is not enough space in queue or, with iCallback, if there are
+    // already EEPROM_COMPLETION_QUEUE_SIZE callbacks pending. iCallback is called by loop(). The queue holds at most
+    // EEPROM_QUEUE_SIZE pages of EEPROM_PAGE_SIZE bytes (256 bytes by default, less for unaligned data),
+    // so larger data has to be written by several calls.
+    bool writeAsync(uint16_t iAddress, const uint8_t *iData, uint16_t iLength, EepromWriteCallback iCallback = nullptr);
+    // compare before write: pages with unchanged content are not written (default EEPROM_SKIP_UNCHANGED)
+    static void skipUnchanged(bool iSkip);
+    // true, if there are no queued pages and no running write cycle
+    static bool idle();
+    // writes the next queued page, called by loop() or on core 1 with OPENKNX_DUALCORE
+    static void process();
+    // processes the asynchronous write queue (not with OPENKNX_DUALCORE) and calls finished callbacks, call this in loop()
+    static void loop();
 };
 
 
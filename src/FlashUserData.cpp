@@ -5,6 +5,7 @@
 #include "hardware.h"
 #include "Helper.h"
 #include "HardwareDevices.h"
+#include "Benchmark.h"
 
 // singleton
 FlashUserData *FlashUserData::_this = nullptr;
@@ -19,54 +20,40 @@ FlashUserData::FlashUserData()
 }
 
 FlashUserData::~FlashUserData()
-{}
+{
+    delete[] _saveBuffer;
+}
 
 bool FlashUserData::readFlash()
 {
     printDebug("read UserData from flash...\n");
-    bool lResult = true;
-    // determine size of data to read from flash
-    size_t userFlashSize = 0;
-    IFlashUserData* next = _first;
-    while (next)
-    {
-        userFlashSize += next->saveSize();
-        next = next->next();
-    }
-    if (userFlashSize > 0 && _flashStart != nullptr)
-    {
-        size_t flashSize = knx.platform().getNonVolatileMemorySize();
-        _userFlashStartRelative = flashSize - userFlashSize - USERDATA_METADATA_SIZE;
-    }
-    if (_userFlashStartRelative == 0)
-    {
+    BENCHMARK_START(lBenchmarkStart);
+    checkIds();
+    allocSaveBuffer();
+    bool lResult = checkRing();
+    if (!lResult)
         printDebug("no flash for UserData available\n");
-        lResult = false;
-    }
-    uint8_t magicWord[USERDATA_METADATA_SIZE];
-    const uint8_t* buffer;
     if (lResult)
     {
-        buffer = _flashStart + _userFlashStartRelative;
-        buffer = popByteArray(magicWord, USERDATA_METADATA_SIZE, buffer);
-
-        for (uint8_t i = 0; i < 4; i++)
-            lResult = lResult && (magicWord[i] == _magicWord[i]);
-    }
-    if (lResult)
-    {
-        next = _first;
-        while (next)
+        if (_ring.find(_magicWord))
         {
-            const uint8_t* start = buffer;
-            buffer = next->restore(buffer);
-            printDebug("%s (%i bytes)\n", next->name(), buffer - start);
-            next = next->next();
+            printDebug("found UserData generation %u in sector %i\n", _ring.generation(), _ring.sector());
+            restoreGeneration();
+        }
+        else
+        {
+            // data from old firmware is restored and written as first generation during next save
+            const uint8_t* buffer = findLegacyData();
+            lResult = (buffer != nullptr);
+            if (lResult)
+                restoreLegacyData(buffer);
         }
-        printDebug("restored UserData\n");
     }
+    if (lResult)
+        printDebug("restored UserData\n");
     else
         printDebug("no valid UserData found in flash\n");
+    BENCHMARK_STOP(flashRestore, lBenchmarkStart, _ring.length());
 
 #ifdef SAVE_INTERRUPT_PIN
     // we need to do this as late as possible, tried in constructor, but this doesn't work on RP2040
@@ -82,57 +69,93 @@ bool FlashUserData::readFlash()
     return lResult;
 }
 
-void FlashUserData::writeFlash(const char* debugText)
+void FlashUserData::writeFlash(const char* debugText, bool iUseBudget /* = false */, bool iSaveInterrupt /* = false */)
 {
     printDebug("%s", debugText);
-    if (knx.configured() && _userFlashStartRelative > 0) 
-    {
-        // we have to ensure, that writeFlash is not called too often, because flash memory 
-        // does not survive too many writes
-        // possible sources for many writes: bouncing of SAVE_PIN, call cascades of beforeTablesUnload and beforeRestart,
-        // and even touching of the NCN5120 may cause multiple SAVE-Interrupts.
-        if (_writeLastCalled == 0 || delayCheck(_writeLastCalled, 180000)) // 3 Minutes delay
-        {  
-            printDebug("... and executed\n");
-            _writeLastCalled = delayTimerInit(); 
-            // first get the necessary size of the writeBuffer
-            uint16_t writeBufferSize = _metadataSize;
-            IFlashUserData* next = _first;
-            while (next)
-            {
-                writeBufferSize = MAX(writeBufferSize, next->saveSize());
-                next = next->next();
-            }
-            uint8_t buffer[writeBufferSize];
-            uint32_t flashPos = _userFlashStartRelative;
-            uint8_t* bufferPos = buffer;
+    if (knx.configured() && _ringValid) 
+    {
+        // a save without changed modules does not write anything,
+        // saves are throttled, because flash memory does not survive too many writes
+        uint32_t lWriteStart = millis();
+        BENCHMARK_START(lBenchmarkStart);
+        // incremental save is just possible, if there is a current generation to copy unchanged records from
+        bool lFullSave = _ring.generation() == 0 || _forceFullSave;
+        // a SAVE-Interrupt is never throttled, it might be the last chance to save, a repeated one writes nothing if nothing changed
+        if (USERDATA_SAVE_INTERVAL > 0 && _writeLastCalled != 0 && !_forceFullSave && !iSaveInterrupt && !delayCheck(_writeLastCalled, USERDATA_SAVE_INTERVAL))
+        {
+            printDebug("... but not executed due to repeated calls to writeFlash() within %i s\n", USERDATA_SAVE_INTERVAL / 1000);
+            return;
+        }
+        // decided before the next sector is touched, so an unchanged save neither erases nor programs flash
+        if (!checkChanges(lFullSave))
+        {
+            printDebug("... but not executed, because no module changed\n");
+            return;
+        }
+        printDebug("... and executed as %s save\n", lFullSave ? "full" : "incremental");
 
-            if (_metadataSize > 0) 
-            {
-                // currently we write just a magic word, there are also examples how we would write other metadata
-                // bufferPos = pushWord(_deviceObject.apiVersion, bufferPos);
-                // bufferPos = pushWord(_deviceObject.manufacturerId(), bufferPos);
-                bufferPos = pushByteArray(_magicWord, USERDATA_METADATA_SIZE, bufferPos);
-                // bufferPos = pushWord(_deviceObject.version(), bufferPos);
+        // new generation goes to the sector after the current generation, which stays valid until the trailer is written
+        uint16_t lSector = _ring.nextSector(recordsSize());
+        uint32_t lGenerationStart = _ring.sectorStart(lSector);
+        uint32_t lGeneration = _ring.generation() + 1;
 
-                flashPos = writeFlash(flashPos, bufferPos - buffer, buffer);
-            }
-            printDebug("saving FlashUserData...\n");
+        uint8_t buffer[USERDATA_HEADER_SIZE];
+        uint8_t* bufferPos = buffer;
+        bufferPos = pushByteArray(_magicWord, USERDATA_METADATA_SIZE, bufferPos);
+        bufferPos = pushInt(lGeneration, bufferPos);
+        bufferPos = pushInt(recordsSize(), bufferPos);
+        bufferPos = pushInt(moduleCount(), bufferPos);
+        uint32_t flashPos = writeFlash(lGenerationStart, bufferPos - buffer, buffer);
+
+        printDebug("saving FlashUserData generation %u...\n", lGeneration);
+        // records are written in order of descending priority, modules of same priority in chain order
+        bool lComplete = true;
+        IFlashUserData* next;
+        int16_t lPriority = 256;
+        while ((lPriority = nextPriority(lPriority)) >= 0)
+        {
             next = _first;
             while (next)
             {
-                bufferPos = next->save(buffer);
-                printDebug("%s (size req: %i, act: %i)\n", next->name(), next->saveSize(), bufferPos - buffer);
-                flashPos = writeFlash(flashPos, bufferPos - buffer, buffer);
+                if (next->savePriority() == lPriority)
+                    flashPos = writeRecord(next, flashPos, iUseBudget, lComplete);
                 next = next->next();
             }
-            saveFlash();
-            printDebug("UserData written to flash, this took %i ms\n", millis() - _writeLastCalled);
         }
-        else
+        if (!lComplete)
+        {
+            // there is space left for records of omitted modules, mark the end of records
+            uint8_t lRecordHeader[USERDATA_RECORD_HEADER_SIZE];
+            bufferPos = pushWord(USERDATA_RECORD_END, lRecordHeader);
+            bufferPos = pushByte(0, bufferPos);
+            bufferPos = pushWord(0, bufferPos);
+            writeFlash(flashPos, USERDATA_RECORD_HEADER_SIZE, lRecordHeader);
+            flashPos = lGenerationStart + USERDATA_HEADER_SIZE + recordsSize();
+        }
+        // the trailer validates the new generation
+        bufferPos = pushInt(lGeneration, buffer);
+        bufferPos = pushByteArray(_magicWord, USERDATA_METADATA_SIZE, bufferPos);
+        flashPos = writeFlash(flashPos, bufferPos - buffer, buffer);
+        uint32_t lCommitStart = micros();
+        saveFlash();
+        _commitDuration = micros() - lCommitStart;
+        BENCHMARK_STOP(flashCommit, lCommitStart, 0);
+        BENCHMARK_STOP(flashSave, lBenchmarkStart, flashPos - lGenerationStart);
+        _ring.commit(lGeneration, lSector, recordsSize());
+        _writeLastCalled = delayTimerInit();
+        // views into flash have to follow the new generation, copied records might be older than the state in RAM
+        next = _first;
+        while (next)
         {
-            printDebug("... but not executed due to repeated calls to writeFlash() within 3 minutes\n");
+            const uint8_t* lRecord = _ring.findRecord(next->_recordId, next->version(), next->saveSize());
+            FlashUserDataView lView(lRecord ? lRecord + USERDATA_RECORD_HEADER_SIZE : nullptr, next->saveSize());
+            if (lRecord && next->_recordWritten)
+                next->restoreView(lView);
+            else if (lRecord)
+                next->relocateView(lView);
+            next = next->next();
         }
+        printDebug("UserData written to flash sector %i, this took %i ms (commit %i us)\n", lSector, millis() - lWriteStart, _commitDuration);
     }
     else
     {
@@ -140,11 +163,171 @@ void FlashUserData::writeFlash(const char* debugText)
     }
 }
 
+// Decides for each module, if its record has to be written. Dirty modules are serialized without writing to
+// flash and compared with their current record. A changed record, which was not written (save budget), stays
+// changed for the next save, because the module reset its dirty flag. Returns true, if any record changed.
+bool FlashUserData::checkChanges(bool iFullSave)
+{
+    bool lChanged = false;
+    for (IFlashUserData* next = _first; next; next = next->next())
+    {
+        uint16_t lLength = next->saveSize();
+        const uint8_t* lRecord = _ring.findRecord(next->_recordId, next->version(), lLength);
+        next->_recordChanged = next->_recordChanged || iFullSave || lRecord == nullptr;
+        if (!next->_recordChanged && next->isDirty())
+        {
+            if (USERDATA_SKIP_UNCHANGED)
+            {
+                _writer.beginCompare(lRecord + USERDATA_RECORD_HEADER_SIZE, lLength);
+                serialize(next);
+                _writer.finish();
+                next->_recordChanged = _writer.changed();
+            }
+            else
+                next->_recordChanged = true;
+        }
+        lChanged = lChanged || next->_recordChanged;
+    }
+    return lChanged;
+}
+
+// the module writes its data to _writer
+void FlashUserData::serialize(IFlashUserData* iModule)
+{
+    // data is streamed through a small fixed buffer, just modules without streaming support need a buffer of saveSize() bytes
+    if (iModule->streamsSave())
+    {
+        if (!iModule->saveStream(_writer))
+            LOG_ERROR("%s supports saveStream(), but did not write anything\n", iModule->name());
+    }
+    else
+    {
+        uint8_t* bufferPos = iModule->save(_saveBuffer);
+        _writer.write(_saveBuffer, bufferPos - _saveBuffer);
+    }
+}
+
+// Each module is written as record of saveSize() bytes, records of unchanged modules are copied from current generation
+uint32_t FlashUserData::writeRecord(IFlashUserData* iModule, uint32_t iFlashPos, bool iUseBudget, bool& oComplete)
+{
+    uint16_t lLength = iModule->saveSize();
+    iModule->_recordWritten = false;
+    const uint8_t* lRecord = _ring.findRecord(iModule->_recordId, iModule->version(), lLength);
+    bool lSave = iModule->_recordChanged;
+    if (lSave && iUseBudget && !withinBudget(iModule))
+    {
+        // not enough time left, keep the previous state of the module, if there is one
+        LOG_INFO("%s skipped, not enough time left\n", iModule->name());
+        lSave = false;
+    }
+    if (!lSave)
+    {
+        if (lRecord)
+        {
+            LOG_DEBUG("%s unchanged\n", iModule->name());
+            return writeFlash(iFlashPos, USERDATA_RECORD_SIZE(lLength), (uint8_t*)lRecord);
+        }
+        oComplete = false;
+        return iFlashPos;
+    }
+
+    uint32_t lSaveStart = micros();
+    uint8_t lRecordHeader[USERDATA_RECORD_HEADER_SIZE];
+    uint8_t* bufferPos = pushWord(iModule->_recordId, lRecordHeader);
+    bufferPos = pushByte(iModule->version(), bufferPos);
+    bufferPos = pushWord(lLength, bufferPos);
+    iFlashPos = writeFlash(iFlashPos, USERDATA_RECORD_HEADER_SIZE, lRecordHeader);
+    _writer.begin(iFlashPos, lLength);
+    serialize(iModule);
+    uint16_t lWritten = _writer.written();
+    bool lOverflow = _writer.overflow();
+    // unused bytes are zeroed to get a defined checksum
+    uint16_t lCrc = _writer.finish();
+    iFlashPos += lLength;
+    uint8_t lRecordTrailer[USERDATA_RECORD_TRAILER_SIZE];
+    pushWord(lCrc, lRecordTrailer);
+    iFlashPos = writeFlash(iFlashPos, USERDATA_RECORD_TRAILER_SIZE, lRecordTrailer);
+    iModule->_saveDuration = micros() - lSaveStart;
+    iModule->_recordWritten = true;
+    iModule->_recordChanged = false;
+    LOG_DEBUG("%s (size req: %i, act: %i, %i us)\n", iModule->name(), lLength, lWritten, iModule->_saveDuration);
+    if (lOverflow)
+        LOG_ERROR("%s tried to write more than %i bytes, data is truncated\n", iModule->name(), lLength);
+    return iFlashPos;
+}
+
+// Modules without streaming support need a buffer of saveSize() bytes. It is allocated once during startup for
+// the largest of these modules, so a save (i.e. during SAVE-Interrupt) neither allocates nor needs saveSize() bytes of stack.
+void FlashUserData::allocSaveBuffer()
+{
+    uint16_t lSize = 0;
+    for (IFlashUserData* next = _first; next; next = next->next())
+        if (!next->streamsSave() && next->saveSize() > lSize)
+            lSize = next->saveSize();
+    delete[] _saveBuffer;
+    _saveBuffer = lSize > 0 ? new uint8_t[lSize] : nullptr;
+    printDebug("save buffer of %i bytes allocated\n", lSize);
+}
+
+// highest priority of all modules below iPriority, -1 if there is none
+int16_t FlashUserData::nextPriority(int16_t iPriority)
+{
+    int16_t lResult = -1;
+    IFlashUserData* next = _first;
+    while (next)
+    {
+        int16_t lPriority = next->savePriority();
+        if (lPriority < iPriority && lPriority > lResult)
+            lResult = lPriority;
+        next = next->next();
+    }
+    return lResult;
+}
+
+// the budget starts with the SAVE-Interrupt and has to cover the final commit to flash
+bool FlashUserData::withinBudget(IFlashUserData* iModule)
+{
+    uint32_t lCost = iModule->_saveDuration > 0 ? iModule->_saveDuration : iModule->saveCost();
+    return micros() - _saveInterruptMicros + lCost + _commitDuration <= _saveBudget;
+}
+
+// Measures iRuns full saves and restores of all modules, results are printed together with all other
+// benchmark results. Each run writes a new generation, so do not use this in production.
+void FlashUserData::benchmark(uint8_t iRuns)
+{
+#ifdef OPENKNX_BENCHMARK
+    Benchmark::flashSave.reset();
+    Benchmark::flashCommit.reset();
+    Benchmark::flashRestore.reset();
+    _forceFullSave = true;
+    for (uint8_t i = 0; i < iRuns; i++)
+    {
+        writeFlash("benchmark save");
+        readFlash();
+    }
+    _forceFullSave = false;
+    Benchmark::print();
+#else
+    (void)iRuns;
+    printDebug("benchmark needs OPENKNX_BENCHMARK to be defined\n");
+#endif
+}
+
+void FlashUserData::saveBudget(uint32_t iMicros)
+{
+    _saveBudget = iMicros;
+}
+
 void FlashUserData::saveFlash()
 {
     knx.platform().commitNonVolatileMemory();
 }
 
+uint32_t FlashUserData::writeFlash(uint32_t relativeAddress, size_t size, uint8_t* data)
+{
+    return knx.platform().writeNonVolatileMemory(relativeAddress, data, size);
+}
+
 void FlashUserData::first(IFlashUserData* obj)
 {
     if (_first != 0)
@@ -157,14 +340,153 @@ IFlashUserData* FlashUserData::first()
     return _first;
 }
 
-uint32_t FlashUserData::writeFlash(uint32_t relativeAddress, size_t size, uint8_t* data)
+size_t FlashUserData::userFlashSize()
 {
-    return knx.platform().writeNonVolatileMemory(relativeAddress, data, size);
+    size_t lSize = 0;
+    IFlashUserData* next = _first;
+    while (next)
+    {
+        lSize += next->saveSize();
+        next = next->next();
+    }
+    return lSize;
+}
+
+size_t FlashUserData::recordsSize()
+{
+    return userFlashSize() + moduleCount() * USERDATA_RECORD_SIZE(0);
+}
+
+uint16_t FlashUserData::moduleCount()
+{
+    uint16_t lCount = 0;
+    IFlashUserData* next = _first;
+    while (next)
+    {
+        lCount++;
+        next = next->next();
+    }
+    return lCount;
+}
+
+IFlashUserData* FlashUserData::findModule(uint16_t iId)
+{
+    IFlashUserData* next = _first;
+    while (next && next->_recordId != iId)
+        next = next->next();
+    return next;
+}
+
+// records can be in any order, each one is validated and restored independent of all others
+void FlashUserData::restoreGeneration()
+{
+    const uint8_t* record = _ring.records();
+    const uint8_t* end = _ring.recordsEnd();
+    while (record + USERDATA_RECORD_SIZE(0) <= end)
+    {
+        uint16_t lId = 0;
+        uint8_t lVersion = 0;
+        uint16_t lLength = 0;
+        const uint8_t* data = FlashUserDataRing::recordData(record, lId, lVersion, lLength);
+        if (lId == USERDATA_RECORD_END)
+            break;
+        if (data + lLength + USERDATA_RECORD_TRAILER_SIZE > end)
+        {
+            printDebug("UserData record %04X exceeds generation, stop restore\n", lId);
+            break;
+        }
+        IFlashUserData* module = findModule(lId);
+        if (module == nullptr)
+            printDebug("UserData record %04X has no module, skipped\n", lId);
+        else if (lVersion != module->version())
+            printDebug("%s has version %i, but record has version %i, skipped\n", module->name(), module->version(), lVersion);
+        else if (lLength != module->saveSize())
+            printDebug("%s has size %i, but record has size %i, skipped\n", module->name(), module->saveSize(), lLength);
+        else if (!FlashUserDataRing::checkRecord(data, lLength))
+            printDebug("%s has checksum error, skipped\n", module->name());
+        else if (module->restoreView(FlashUserDataView(data, lLength)))
+            printDebug("%s (%i bytes in place)\n", module->name(), lLength);
+        else
+        {
+            const uint8_t* restoreEnd = module->restore(data);
+            printDebug("%s (%i bytes)\n", module->name(), restoreEnd - data);
+        }
+        record = data + lLength + USERDATA_RECORD_TRAILER_SIZE;
+    }
+}
+
+// the old format stores modules in chain order without gaps
+void FlashUserData::restoreLegacyData(const uint8_t* iBuffer)
+{
+    IFlashUserData* next = _first;
+    while (next)
+    {
+        const uint8_t* start = iBuffer;
+        iBuffer = next->restore(iBuffer);
+        printDebug("%s (%i bytes)\n", next->name(), iBuffer - start);
+        next = next->next();
+    }
+}
+
+// records are assigned to modules by id, modules without id get one derived from their position in chain
+void FlashUserData::checkIds()
+{
+    uint16_t lPosition = 0;
+    for (IFlashUserData* next = _first; next; next = next->next(), lPosition++)
+    {
+        uint16_t lId = next->id();
+        if (lId == USERDATA_RECORD_NONE || lId >= USERDATA_RECORD_POSITION)
+        {
+            next->_recordId = USERDATA_RECORD_POSITION + lPosition;
+            printDebug("%s has no valid id (%04X), stored by position as %04X\n", next->name(), lId, next->_recordId);
+            continue;
+        }
+        next->_recordId = lId;
+        for (IFlashUserData* other = next->next(); other; other = other->next())
+        {
+            if (other->id() == lId)
+            {
+                printDebug("%s and %s have the same id %04X\n", next->name(), other->name(), lId);
+                fatalError(FATAL_USERDATA, "UserData modules with same id");
+            }
+        }
+    }
+}
+
+// size and position of the ring are fixed, the generation of all modules has to fit into half of the ring
+bool FlashUserData::checkRing()
+{
+    _ringValid = false;
+    if (_flashStart == nullptr)
+        return false;
+    if (!_ring.init(_flashStart, knx.platform().getNonVolatileMemorySize()))
+        fatalError(FATAL_USERDATA, "UserData ring exceeds half of flash");
+    if (!FlashUserDataRing::fits(recordsSize()))
+    {
+        printDebug("UserData needs %i bytes, but a generation can take just %i bytes\n", USERDATA_HEADER_SIZE + recordsSize() + USERDATA_TRAILER_SIZE, FlashUserDataRing::maxSize());
+        fatalError(FATAL_USERDATA, "UserData does not fit into flash ring, increase USERDATA_SECTOR_COUNT");
+    }
+    _ringValid = true;
+    return true;
+}
+
+// old firmware stored user data at a fixed position at the end of flash
+const uint8_t* FlashUserData::findLegacyData()
+{
+    size_t flashSize = knx.platform().getNonVolatileMemorySize();
+    const uint8_t* buffer = _flashStart + flashSize - userFlashSize() - USERDATA_METADATA_SIZE;
+    if (memcmp(buffer, _legacyMagicWord, USERDATA_METADATA_SIZE) == 0)
+    {
+        printDebug("found UserData of old firmware\n");
+        return buffer + USERDATA_METADATA_SIZE;
+    }
+    return nullptr;
 }
 
 void FlashUserData::onBeforeRestartHandler()
 {
     _this->writeFlash("beforeRestartHandler called");
+    prepareRestart();
 }
 
 void FlashUserData::onBeforeTablesUnloadHandler()
@@ -174,7 +496,9 @@ void FlashUserData::onBeforeTablesUnloadHandler()
 
 void FlashUserData::onSafePinInterruptHandler()
 {
-    printDebug("savePinInterruptHandler called\n");
+    LOG_DEBUG("savePinInterruptHandler called\n");
+    if (!_this->_saveInterruptHandlerCalled)
+        _this->_saveInterruptMicros = micros();
     _this->_saveInterruptHandlerCalled = true;
 }
 
@@ -197,10 +521,10 @@ void FlashUserData::processSaveInterrupt()
             next->powerOff();
             next = next->next();
         }
-        printDebug("all modules turned power off\n");
+        LOG_DEBUG("all modules turned power off\n");
         // write all userdata to flash
-        _this->writeFlash("writeFlash called");
-        printDebug("\n");
+        _this->writeFlash("writeFlash called", _this->_saveBudget > 0, true);
+        LOG_DEBUG("\n");
         // in case it was a jitter on the SAVE-Pin, we restore power after save
 
         restorePower();
@@ -214,7 +538,11 @@ void FlashUserData::processSaveInterrupt()
         if (noReboot)
             printDebug("\nall modules restored power\n");
         else
+        {
+            printDebugFlush();
+            prepareRestart();
             knx.platform().restart();
+        }
         _saveInterruptHandlerCalled = false;
         printDebug("SaveInterrupt was handled correctly\n");
 
@@ -3,8 +3,24 @@
 // #include <stdint.h>
 #include <stddef.h>
 #include "IFlashUserData.h"
+#include "FlashUserDataRing.h"
 
-#define USERDATA_METADATA_SIZE 4
+// time in microseconds between SAVE-Interrupt and power loss available for saving, 0 means unlimited.
+// Within this budget, records are written by priority, modules which do not fit keep their previous record.
+#ifndef USERDATA_SAVE_BUDGET
+#define USERDATA_SAVE_BUDGET 0
+#endif
+// minimum time between two saves in ms, 0 disables the check. Protects flash against call cascades of
+// beforeTablesUnload and beforeRestart. Saves of a SAVE-Interrupt are not throttled, repeated SAVE-Interrupts
+// (bouncing SAVE_PIN, touching the NCN5120) do not write flash, as long as no module changed (USERDATA_SKIP_UNCHANGED).
+#ifndef USERDATA_SAVE_INTERVAL
+#define USERDATA_SAVE_INTERVAL 180000
+#endif
+// dirty modules are compared with their record before anything is written, if none of them changed,
+// flash is not touched at all (no erase, no new generation). Set to 0 to save whenever a module is dirty.
+#ifndef USERDATA_SKIP_UNCHANGED
+#define USERDATA_SKIP_UNCHANGED 1
+#endif
 
 class FlashUserData
 {
@@ -18,26 +34,53 @@ public:
     IFlashUserData* first();
     bool readFlash();
     void loop();
+    // time budget in microseconds for SAVE-Interrupt processing, 0 means unlimited
+    void saveBudget(uint32_t iMicros);
+    // debug only: measure iRuns full saves and restores, needs OPENKNX_BENCHMARK
+    void benchmark(uint8_t iRuns);
 
 private:
     // singleton
     static FlashUserData* _this;
     
-    uint8_t _magicWord[USERDATA_METADATA_SIZE] = {0xDA, 0x77, 0x6E, 0x82};
+    uint8_t _magicWord[USERDATA_METADATA_SIZE] = {0xDA, 0x77, 0x6E, 0x84};
+    // magic word of the old format at a fixed position at the end of flash
+    uint8_t _legacyMagicWord[USERDATA_METADATA_SIZE] = {0xDA, 0x77, 0x6E, 0x82};
 
     static void onBeforeRestartHandler();
     static void onBeforeTablesUnloadHandler();
 
     void processSaveInterrupt();
-    void writeFlash(const char* debugText);
+    void writeFlash(const char* debugText, bool iUseBudget = false, bool iSaveInterrupt = false);
+    bool checkChanges(bool iFullSave);
+    void serialize(IFlashUserData* iModule);
+    uint32_t writeRecord(IFlashUserData* iModule, uint32_t iFlashPos, bool iUseBudget, bool& oComplete);
+    int16_t nextPriority(int16_t iPriority);
+    bool withinBudget(IFlashUserData* iModule);
     uint32_t writeFlash(uint32_t relativeAddress, size_t size, uint8_t* data);
+    void allocSaveBuffer();
     void saveFlash();
+    size_t userFlashSize();
+    size_t recordsSize();
+    uint16_t moduleCount();
+    IFlashUserData* findModule(uint16_t iId);
+    bool checkRing();
+    void checkIds();
+    void restoreGeneration();
+    const uint8_t* findLegacyData();
+    void restoreLegacyData(const uint8_t* iBuffer);
 
     // first class to call for serialization data
     IFlashUserData* _first = 0;
-    uint16_t _metadataSize = USERDATA_METADATA_SIZE; // space for magic word at the beginning of flash space for user data
+    FlashUserDataWriter _writer;
+    uint8_t* _saveBuffer = nullptr; // for modules without saveStream(), sized for the largest of them by readFlash()
     uint32_t _writeLastCalled = 0;
-    size_t _userFlashStartRelative = 0; 
+    FlashUserDataRing _ring;
+    bool _ringValid = false;
     uint8_t* _flashStart = 0;
-    bool _saveInterruptHandlerCalled = false;
+    volatile bool _saveInterruptHandlerCalled = false;
+    volatile uint32_t _saveInterruptMicros = 0;
+    uint32_t _saveBudget = USERDATA_SAVE_BUDGET;
+    uint32_t _commitDuration = 0; // measured duration of last commit in microseconds
+    bool _forceFullSave = false;
 };
@@ -0,0 +1,153 @@
+#include "FlashUserDataRing.h"
+
+#include <string.h>
+#include "knx/bits.h"
+#include "Helper.h"
+
+// The knx stack allocates its tables from the start of non-volatile memory, the ring is placed at its end.
+// The stack does not publish the end of its allocations, so the ring is limited to half of the memory.
+bool FlashUserDataRing::init(const uint8_t* iFlashStart, size_t iFlashSize)
+{
+    size_t lRingSize = (size_t)USERDATA_SECTOR_COUNT * USERDATA_SECTOR_SIZE;
+    _flashStart = nullptr;
+    _generation = 0;
+    if (iFlashStart == nullptr || lRingSize > iFlashSize / 2)
+        return false;
+    _flashStart = iFlashStart;
+    _ringStartRelative = iFlashSize - lRingSize;
+    return true;
+}
+
+uint16_t FlashUserDataRing::sectors()
+{
+    return USERDATA_SECTOR_COUNT;
+}
+
+uint32_t FlashUserDataRing::sectorStart(uint16_t iSector)
+{
+    return _ringStartRelative + (uint32_t)iSector * USERDATA_SECTOR_SIZE;
+}
+
+uint16_t FlashUserDataRing::sectorsOf(size_t iRecordsSize)
+{
+    return (USERDATA_HEADER_SIZE + iRecordsSize + USERDATA_TRAILER_SIZE + USERDATA_SECTOR_SIZE - 1) / USERDATA_SECTOR_SIZE;
+}
+
+size_t FlashUserDataRing::maxSize()
+{
+    return (size_t)(USERDATA_SECTOR_COUNT / 2) * USERDATA_SECTOR_SIZE;
+}
+
+bool FlashUserDataRing::fits(size_t iRecordsSize)
+{
+    return USERDATA_HEADER_SIZE + iRecordsSize + USERDATA_TRAILER_SIZE <= maxSize();
+}
+
+// boot time lookup depends on the number of sectors, but not on the number of saves
+bool FlashUserDataRing::find(const uint8_t* iMagicWord)
+{
+    _generation = 0;
+    if (_flashStart == nullptr)
+        return false;
+    for (uint16_t lSector = 0; lSector < sectors(); lSector++)
+    {
+        const uint8_t* buffer = _flashStart + sectorStart(lSector);
+        if (memcmp(buffer, iMagicWord, USERDATA_METADATA_SIZE) != 0)
+            continue;
+        uint32_t lGeneration = 0;
+        uint32_t lLength = 0;
+        buffer = popInt(lGeneration, buffer + USERDATA_METADATA_SIZE);
+        buffer = popInt(lLength, buffer);
+        if (!fits(lLength) || lSector + sectorsOf(lLength) > sectors())
+            continue;
+        // generation is valid just with a matching trailer
+        uint32_t lTrailerGeneration = 0;
+        buffer = popInt(lTrailerGeneration, _flashStart + sectorStart(lSector) + USERDATA_HEADER_SIZE + lLength);
+        if (lTrailerGeneration != lGeneration || memcmp(buffer, iMagicWord, USERDATA_METADATA_SIZE) != 0)
+            continue;
+        if (lGeneration > _generation)
+            commit(lGeneration, lSector, lLength);
+    }
+    return _generation > 0;
+}
+
+uint16_t FlashUserDataRing::nextSector(size_t iRecordsSize)
+{
+    if (_generation == 0)
+        return 0;
+    uint16_t lSectors = sectorsOf(iRecordsSize);
+    uint16_t lNext = _sector + sectorsOf(_length);
+    if (lNext + lSectors <= sectors())
+        return lNext;
+    // wrap around, with same size as the current generation this never overlaps it
+    if (lSectors > _sector)
+        printDebug("UserData changed its size, the new generation overwrites the current one\n");
+    return 0;
+}
+
+void FlashUserDataRing::commit(uint32_t iGeneration, uint16_t iSector, size_t iLength)
+{
+    _generation = iGeneration;
+    _sector = iSector;
+    _length = iLength;
+}
+
+uint32_t FlashUserDataRing::generation()
+{
+    return _generation;
+}
+
+uint16_t FlashUserDataRing::sector()
+{
+    return _sector;
+}
+
+size_t FlashUserDataRing::length()
+{
+    return _length;
+}
+
+const uint8_t* FlashUserDataRing::records()
+{
+    return _flashStart + sectorStart(_sector) + USERDATA_HEADER_SIZE;
+}
+
+const uint8_t* FlashUserDataRing::recordsEnd()
+{
+    return records() + (_generation > 0 ? _length : 0);
+}
+
+const uint8_t* FlashUserDataRing::recordData(const uint8_t* iRecord, uint16_t& oId, uint8_t& oVersion, uint16_t& oLength)
+{
+    const uint8_t* data = popWord(oId, iRecord);
+    data = popByte(oVersion, data);
+    return popWord(oLength, data);
+}
+
+const uint8_t* FlashUserDataRing::findRecord(uint16_t iId, uint8_t iVersion, uint16_t iLength)
+{
+    if (_generation == 0)
+        return nullptr;
+    const uint8_t* record = records();
+    const uint8_t* end = recordsEnd();
+    while (record + USERDATA_RECORD_SIZE(0) <= end)
+    {
+        uint16_t lId = 0;
+        uint8_t lVersion = 0;
+        uint16_t lLength = 0;
+        const uint8_t* data = recordData(record, lId, lVersion, lLength);
+        if (lId == USERDATA_RECORD_END || data + lLength + USERDATA_RECORD_TRAILER_SIZE > end)
+            break;
+        if (lId == iId)
+            return (lVersion == iVersion && lLength == iLength && checkRecord(data, lLength)) ? record : nullptr;
+        record = data + lLength + USERDATA_RECORD_TRAILER_SIZE;
+    }
+    return nullptr;
+}
+
+bool FlashUserDataRing::checkRecord(const uint8_t* iData, uint16_t iLength)
+{
+    uint16_t lCrc = 0;
+    popWord(lCrc, iData + iLength);
+    return lCrc == crc16(iData, iLength);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define USERDATA_METADATA_SIZE 4
+// header of each generation: magic word, generation, length of all records, number of records
+#define USERDATA_HEADER_SIZE 16
+// trailer of each generation: generation, magic word. A generation is valid just if its trailer was written
+#define USERDATA_TRAILER_SIZE 8
+// each module is stored in a record: id (2 bytes), version (1 byte), length (2 bytes), data, CRC-16 of data
+#define USERDATA_RECORD_HEADER_SIZE 5
+#define USERDATA_RECORD_TRAILER_SIZE 2
+#define USERDATA_RECORD_SIZE(length) (USERDATA_RECORD_HEADER_SIZE + (length) + USERDATA_RECORD_TRAILER_SIZE)
+// id of a record without data marking the end of records, if records of modules were omitted
+#define USERDATA_RECORD_END 0xFFFF
+// id of modules which did not override id(), no record is written with this id
+#define USERDATA_RECORD_NONE 0
+// modules without valid id are stored with this id plus their position in chain (like the old format),
+// ids from here on are reserved
+#define USERDATA_RECORD_POSITION 0xFF00
+
+// User data is stored as a log of generations in a ring of flash sectors at the end of the knx flash.
+// Each save writes a new generation starting at the sector after the previous one (wrapping around at the end
+// of the ring), the previous generation stays valid until the new one is complete. So all sectors of the ring
+// are written in turn. A sector has to be a multiple of the flash erase block size.
+#ifndef USERDATA_SECTOR_SIZE
+#ifdef ARDUINO_ARCH_RP2040
+#define USERDATA_SECTOR_SIZE 4096
+#else
+#define USERDATA_SECTOR_SIZE 256
+#endif
+#endif
+// Number of sectors of the ring. Size and position of the ring are fixed, so they do not change,
+// if modules are added, removed or resized. A generation (header, records, trailer) can take up to half
+// of the ring: 8 KB on RP2040, 2 KB on SAMD (old firmware needed less than this for all its user data).
+#ifndef USERDATA_SECTOR_COUNT
+#ifdef ARDUINO_ARCH_RP2040
+#define USERDATA_SECTOR_COUNT 4
+#else
+#define USERDATA_SECTOR_COUNT 16
+#endif
+#endif
+
+static_assert(USERDATA_SECTOR_COUNT >= 2, "UserData ring needs at least 2 sectors");
+
+/**
+ * Layout of user data in flash, independent of the knx platform: the ring of sectors, the generations
+ * stored there and the records of a generation. Addresses are relative to the start of non-volatile memory.
+ */
+class FlashUserDataRing
+{
+  public:
+    // ring at the end of iFlashSize bytes of memory-mapped flash, false if the ring does not fit
+    bool init(const uint8_t* iFlashStart, size_t iFlashSize);
+    static uint16_t sectors();
+    uint32_t sectorStart(uint16_t iSector);
+    // number of sectors taken by a generation with records of iRecordsSize bytes
+    static uint16_t sectorsOf(size_t iRecordsSize);
+    // true, if a generation with records of iRecordsSize bytes fits into half of the ring
+    static bool fits(size_t iRecordsSize);
+    // maximum size of a generation (header, records, trailer)
+    static size_t maxSize();
+
+    // finds the newest valid generation, just sector starts are checked
+    bool find(const uint8_t* iMagicWord);
+    // first sector for the next generation: the sector after the current generation, or the first sector of the
+    // ring, if the generation does not fit up to the end. The current generation stays valid until the next one
+    // is complete, unless there is no place without overlap (just after a change of size).
+    uint16_t nextSector(size_t iRecordsSize);
+    // the generation written to iSector is complete and is the current generation now
+    void commit(uint32_t iGeneration, uint16_t iSector, size_t iLength);
+
+    // newest valid generation, 0 if there is none
+    uint32_t generation();
+    uint16_t sector();
+    // length of all records in current generation
+    size_t length();
+
+    // records of current generation: first record, end of records
+    const uint8_t* records();
+    const uint8_t* recordsEnd();
+    // reads the header of the record at iRecord and returns its data
+    static const uint8_t* recordData(const uint8_t* iRecord, uint16_t& oId, uint8_t& oVersion, uint16_t& oLength);
+    // finds a valid record with given id, version and length in the current generation
+    const uint8_t* findRecord(uint16_t iId, uint8_t iVersion, uint16_t iLength);
+    // checks the CRC following iLength bytes of data
+    static bool checkRecord(const uint8_t* iData, uint16_t iLength);
+
+  private:
+    const uint8_t* _flashStart = nullptr;
+    uint32_t _ringStartRelative = 0;
+    uint32_t _generation = 0;
+    uint16_t _sector = 0;
+    size_t _length = 0;
+};
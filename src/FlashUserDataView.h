@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Read-only, bounds-checked view into the record of a module in memory-mapped flash.
+ * Data is not copied, so a module can keep read-only state (i.e. lookup tables) referenced in place.
+ */
+class FlashUserDataView
+{
+  public:
+    FlashUserDataView(const uint8_t* iData = nullptr, uint16_t iSize = 0)
+        : _data(iData), _size(iData ? iSize : 0) {}
+
+    const uint8_t* data() const
+    {
+        return _data;
+    }
+
+    uint16_t size() const
+    {
+        return _size;
+    }
+
+    bool valid() const
+    {
+        return _data != nullptr;
+    }
+
+    /**
+     * @return Pointer to iLength bytes starting at iOffset, nullptr if they are not completely inside the view.
+     */
+    const uint8_t* at(uint16_t iOffset, uint16_t iLength = 1) const
+    {
+        if (!valid() || (uint32_t)iOffset + iLength > _size)
+            return nullptr;
+        return _data + iOffset;
+    }
+
+    /**
+     * Copies iLength bytes starting at iOffset to oData.
+     *
+     * @return false, if the bytes are not completely inside the view (nothing is copied then).
+     */
+    bool read(uint16_t iOffset, uint8_t* oData, uint16_t iLength) const
+    {
+        const uint8_t* lData = at(iOffset, iLength);
+        if (lData)
+            memcpy(oData, lData, iLength);
+        return lData != nullptr;
+    }
+
+    /**
+     * @return A view of iLength bytes starting at iOffset, an invalid view if out of bounds.
+     */
+    FlashUserDataView sub(uint16_t iOffset, uint16_t iLength) const
+    {
+        return FlashUserDataView(at(iOffset, iLength), iLength);
+    }
+
+  private:
+    const uint8_t* _data;
+    uint16_t _size;
+};
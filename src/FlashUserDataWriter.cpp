@@ -0,0 +1,102 @@
+#include "FlashUserDataWriter.h"
+
+#include "knx.h"
+#include "Helper.h"
+
+void FlashUserDataWriter::begin(uint32_t iRelativeAddress, uint16_t iLength)
+{
+    _flashPos = iRelativeAddress;
+    _length = iLength;
+    _bufferUsed = 0;
+    _written = 0;
+    _crc = 0xFFFF;
+    _overflow = false;
+    _reference = nullptr;
+    _changed = false;
+}
+
+void FlashUserDataWriter::beginCompare(const uint8_t* iReference, uint16_t iLength)
+{
+    begin(0, iLength);
+    _reference = iReference;
+}
+
+bool FlashUserDataWriter::changed()
+{
+    return _changed;
+}
+
+uint16_t FlashUserDataWriter::finish()
+{
+    while (_written < _length)
+        writeByte(0);
+    flush();
+    return _crc;
+}
+
+void FlashUserDataWriter::write(const uint8_t* iData, size_t iLength)
+{
+    if (iLength > (size_t)(_length - _written))
+    {
+        _overflow = true;
+        iLength = _length - _written;
+    }
+    if (_reference)
+    {
+        // compare only, there is no need for CRC and buffer
+        _changed = _changed || memcmp(_reference + _written, iData, iLength) != 0;
+        _written += iLength;
+        return;
+    }
+    while (iLength > 0)
+    {
+        // buffer is flushed at each page boundary, so all chunks except the first one are page aligned
+        uint16_t lChunk = USERDATA_WRITE_BUFFER_SIZE - (_flashPos + _bufferUsed) % USERDATA_WRITE_BUFFER_SIZE;
+        lChunk = MIN(lChunk, iLength);
+        memcpy(_buffer + _bufferUsed, iData, lChunk);
+        _crc = crc16(iData, lChunk, _crc);
+        _bufferUsed += lChunk;
+        _written += lChunk;
+        iData += lChunk;
+        iLength -= lChunk;
+        if ((_flashPos + _bufferUsed) % USERDATA_WRITE_BUFFER_SIZE == 0)
+            flush();
+    }
+}
+
+void FlashUserDataWriter::writeByte(uint8_t iValue)
+{
+    write(&iValue, 1);
+}
+
+void FlashUserDataWriter::writeWord(uint16_t iValue)
+{
+    uint8_t lData[2];
+    pushWord(iValue, lData);
+    write(lData, 2);
+}
+
+void FlashUserDataWriter::writeInt(uint32_t iValue)
+{
+    uint8_t lData[4];
+    pushInt(iValue, lData);
+    write(lData, 4);
+}
+
+uint16_t FlashUserDataWriter::written()
+{
+    return _written;
+}
+
+bool FlashUserDataWriter::overflow()
+{
+    return _overflow;
+}
+
+void FlashUserDataWriter::flush()
+{
+    if (_bufferUsed == 0)
+        return;
+    _flashPos = knx.platform().writeNonVolatileMemory(_flashPos, _buffer, _bufferUsed);
+    _bufferUsed = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// size of the write buffer, has to be a divisor of the flash page size. Chunks are flushed page aligned.
+#ifndef USERDATA_WRITE_BUFFER_SIZE
+#define USERDATA_WRITE_BUFFER_SIZE 64
+#endif
+
+/**
+ * Streaming writer for the record of a module in flash.
+ * Data is collected in a small fixed buffer and flushed to flash whenever the buffer is full,
+ * so RAM usage during SAVE does not depend on number or size of modules.
+ * The writer never writes more than saveSize() bytes, additional data is dropped and marked as overflow.
+ */
+class FlashUserDataWriter
+{
+  public:
+    void write(const uint8_t* iData, size_t iLength);
+    void writeByte(uint8_t iValue);
+    // multibyte values are written big endian, like pushWord()/pushInt()
+    void writeWord(uint16_t iValue);
+    void writeInt(uint32_t iValue);
+
+    // number of bytes written so far
+    uint16_t written();
+    // true, if there was an attempt to write more than the record can take
+    bool overflow();
+
+  private:
+    friend class FlashUserData;
+
+    // start a record at the given flash position (relative to non-volatile memory start)
+    void begin(uint32_t iRelativeAddress, uint16_t iLength);
+    // start a record, which is just compared with iReference (the data of the current record), nothing is written to flash
+    void beginCompare(const uint8_t* iReference, uint16_t iLength);
+    // fill the record with zeros up to its length, flush it and return the CRC-16 of the record data
+    uint16_t finish();
+    void flush();
+    // true, if data written since beginCompare() differs from the reference
+    bool changed();
+
+    uint8_t _buffer[USERDATA_WRITE_BUFFER_SIZE];
+    uint16_t _bufferUsed = 0;
+    uint32_t _flashPos = 0;
+    uint16_t _length = 0;
+    uint16_t _written = 0;
+    uint16_t _crc = 0xFFFF;
+    bool _overflow = false;
+    const uint8_t* _reference = nullptr; // compare only, if set
+    bool _changed = false;
+};
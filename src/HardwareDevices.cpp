@@ -2,9 +2,15 @@
 #include "Helper.h"
 #include "EepromManager.h"
 #include "HardwareDevices.h"
+#include "Benchmark.h"
+#include "Ncn5130.h"
+#include "I2cRegistry.h"
 #ifdef WATCHDOG
 #include <Adafruit_SleepyDog.h>
 #endif
+#ifdef ARDUINO_ARCH_RP2040
+#include <hardware/watchdog.h>
+#endif
 
 uint8_t boardHardware = 0;
 
@@ -22,38 +28,73 @@ void ledProg(bool iOn)
 #endif
 }
 
+static void onPowerOffConfirmed(bool iSuccess, uint8_t /* iResponse */, uint8_t /* iData */)
+{
+    if (!iSuccess)
+        LOG_ERROR("savePower: NCN5130 did not confirm 5V / 20V rail off\n");
+}
+
+// rails are switched off first, without waiting for the NCN5130.
+// Confirmations are processed by Ncn5130::loop() (at the latest in restorePower())
 void savePower()
 {
+    uint32_t lStart = micros();
+    // init knx-uart to be in control mode, this does nothing if it is initialized already
+    initUart();
+    // turn off 5V and 20V rail, this must not wait behind a running command
+    uint8_t lBuffer[] = {U_INT_REG_WR_REQ_ACR0, ACR0_FLAG_XCLKEN | ACR0_FLAG_V20VCLIMIT };
+    Ncn5130::sendImmediate(lBuffer, 2);
+    uint32_t lRailsOff = micros() - lStart;
     // turn off known LED's
     ledProg(false);
     ledInfo(false);
-    // init knx-uart to be in control mode
-    initUart();
-    printDebug("savePower: Stop UART KNX communication...\n");
-    sendUartCommand("STOP_MODE", U_STOP_MODE_REQ, U_STOP_MODE_IND);
-    printDebug("savePower: Switching off 5V / 20V rail...\n");
-    // turn off 5V and 20V rail 
-    uint8_t lBuffer[] = {U_INT_REG_WR_REQ_ACR0, ACR0_FLAG_XCLKEN | ACR0_FLAG_V20VCLIMIT };
     // get rid of knx reference
-    Serial1.write(lBuffer, 2);
-    // sendUartCommand("READ_ACR0 (Analog control register 0)", U_INT_REG_RD_REQ_ACR0, ACR0_FLAG_XCLKEN | ACR0_FLAG_V20VCLIMIT);
+    Ncn5130::send(U_STOP_MODE_REQ, U_STOP_MODE_IND, 0, nullptr, "STOP_MODE");
+    Ncn5130::send(U_INT_REG_RD_REQ_ACR0, ACR0_FLAG_XCLKEN | ACR0_FLAG_V20VCLIMIT, 0, onPowerOffConfirmed, "READ_ACR0");
+    BENCHMARK_STOP(powerOff, lStart, 0);
+    LOG_DEBUG("savePower: 5V / 20V rail switched off after %d us, done after %d us\n", lRailsOff, micros() - lStart);
 }
 
+// waits for bus voltage (SAVE pin), rails are confirmed by reading ACR0
 void restorePower(){
-    delay(500);
-    printDebug("restorePower: Switching on 5V rail...\n");
-    // turn on 5V and 20V rail
-    uint8_t lBuffer[] = {U_INT_REG_WR_REQ_ACR0, ACR0_FLAG_DC2EN | ACR0_FLAG_V20VEN | ACR0_FLAG_XCLKEN | ACR0_FLAG_V20VCLIMIT};
+    uint32_t lStart = micros();
     initUart();
-    Serial1.write(lBuffer, 2);
+    // pending confirmations of savePower() come first
+    while (!Ncn5130::idle())
+        Ncn5130::loop();
+#ifdef SAVE_INTERRUPT_PIN
+    uint32_t lWaitStart = millis();
+    // SAVE pin is high as long as the bus voltage is ok
+    while (digitalRead(SAVE_INTERRUPT_PIN) == LOW && !delayCheck(lWaitStart, RESTORE_POWER_TIMEOUT))
+        ;
+#else
+    delay(RESTORE_POWER_TIMEOUT);
+#endif
+    uint32_t lBusOk = micros() - lStart;
+    LOG_DEBUG("restorePower: Switching on 5V rail...\n");
+    // turn on 5V and 20V rail
+    const uint8_t lRails = ACR0_FLAG_DC2EN | ACR0_FLAG_V20VEN | ACR0_FLAG_XCLKEN | ACR0_FLAG_V20VCLIMIT;
+    uint8_t lBuffer[] = {U_INT_REG_WR_REQ_ACR0, lRails};
+    Ncn5130::send(lBuffer, 2, NCN5130_NO_RESPONSE);
+    if (Ncn5130::execute(U_INT_REG_RD_REQ_ACR0, lRails, 0, "READ_ACR0") != lRails)
+        LOG_ERROR("restorePower: NCN5130 did not confirm 5V / 20V rail on\n");
+    uint32_t lRailsOn = micros() - lStart;
     // give all sensors some time to init
-    delay(100);
-    printDebug("restorePower: Start UART KNX communication...\n");
+    delay(RESTORE_POWER_SETTLE_TIME);
+    LOG_DEBUG("restorePower: Start UART KNX communication...\n");
     sendUartCommand("EXIT_STOP_MODE", U_EXIT_STOP_MODE_REQ, U_RESET_IND);
+    BENCHMARK_STOP(powerOn, lStart, 0);
+    LOG_DEBUG("restorePower: bus ok after %d us, 5V / 20V rail on after %d us, done after %d us\n", lBusOk, lRailsOn, micros() - lStart);
 }
 
 void fatalError(uint8_t iErrorCode, const char* iErrorText) {
     const uint16_t lDelay = 200;
+#ifdef UNIT_TEST
+    // native unit tests fail instead of blinking forever
+    printDebug("FatalError %d: %s\n", iErrorCode, iErrorText);
+    printDebugFlush();
+    abort();
+#endif
 #ifdef WATCHDOG
     Watchdog.disable();
 #endif
@@ -62,6 +103,7 @@ void fatalError(uint8_t iErrorCode, const char* iErrorText) {
         // we repeat the message on serial bus, so we can get it even 
         // if we connect USB later
         printDebug("FatalError %d: %s\n", iErrorCode, iErrorText);
+        printDebugFlush();
         ledInfo(true);
         delay(lDelay);
         // number of red blinks during a yellow blink is the error code
@@ -77,11 +119,62 @@ void fatalError(uint8_t iErrorCode, const char* iErrorText) {
     }
 }
 
+// The probe result is kept in a watchdog scratch register, which survives a warm boot (watchdog or
+// software reset), but not a power cycle. Flash user data is restored after boardCheck() and the EEPROM
+// is probed itself, so there is no other non-volatile memory available at this time.
+// The register is written just by prepareRestart() and cleared on each boot, so an unexpected reset
+// (i.e. watchdog) probes the board again.
+static bool readProbeCache()
+{
+#ifdef ARDUINO_ARCH_RP2040
+    uint32_t lCache = watchdog_hw->scratch[BOARD_PROBE_SCRATCH];
+    watchdog_hw->scratch[BOARD_PROBE_SCRATCH] = 0;
+    if (watchdog_caused_reboot() && (lCache & 0xFFFFFF00) == BOARD_PROBE_MAGIC)
+    {
+        boardHardware = lCache & 0xFF;
+        return true;
+    }
+#endif
+    return false;
+}
+
+void prepareRestart()
+{
+#ifdef ARDUINO_ARCH_RP2040
+    watchdog_hw->scratch[BOARD_PROBE_SCRATCH] = BOARD_PROBE_MAGIC | boardHardware;
+#endif
+}
+
+static void onUartProbe(bool iSuccess, uint8_t /* iResponse */, uint8_t iData)
+{
+    // system state: operation mode normal
+    bool lResult = iSuccess && (iData & 3) == 3;
+    printDebug("UART %s\n", lResult ? "found" : "not found");
+    if (lResult)
+        boardHardware |= BOARD_HW_NCN5130;
+}
+
+// the UART response is processed by Ncn5130::loop(), while I2C devices are probed
+static void startUartProbe()
+{
+    initUart();
+    Ncn5130::send(U_SYSTEM_STATE, U_SYSTEM_STAT_IND, 1, onUartProbe, "SYSTEM_STATE", BOARD_PROBE_UART_TIMEOUT);
+}
+
 // call this BEFORE Wire.begin()
 // it clears I2C Bus, calls Wire.begin() and checks which board hardware is available
 bool boardCheck()
 {
-    bool lResult = checkUartExistence();
+    BENCHMARK_START(lBenchmarkStart);
+    bool lCached = readProbeCache();
+    bool lResult = lCached;
+    if (lCached)
+    {
+        printDebug("Board hardware %02X known from before restart, probing skipped\n", boardHardware);
+        initUart();
+    }
+    else
+        startUartProbe();
 
 #ifndef NO_I2C
     // first we clear I2C-Bus
@@ -91,7 +184,7 @@ bool boardCheck()
     if (lI2c != 0) {
         // we try to turn off power for the attached sensors or Hardware. Does not work on all devices
         savePower();
-        delay(5000);
+        delay(I2C_POWER_CYCLE_TIME);
         restorePower();
         lI2c = clearI2cBus();
     }
@@ -116,17 +209,6 @@ bool boardCheck()
     if (!lResult) {
         fatalError(FATAL_I2C_BUSY, "Failed to initialize I2C-Bus");
     }
-#ifdef I2C_EEPROM_DEVICE_ADDRESSS
-    // we check here Hardware we rely on
-    printDebug("Checking EEPROM existence... ");
-    // check for I2C ack
-    Wire.beginTransmission(I2C_EEPROM_DEVICE_ADDRESSS);
-    lResult = (Wire.endTransmission() == 0);
-    if (lResult)
-        boardHardware |= BOARD_HW_EEPROM;
-    printResult(lResult);
-#endif
-
 #ifdef I2C_1WIRE_DEVICE_ADDRESSS
 #ifdef ARDUINO_ARCH_RP2040
     TwoWire &lWire = Wire1;
@@ -134,107 +216,65 @@ bool boardCheck()
     TwoWire &lWire = Wire;
 #endif
     lWire.begin();
+#endif
+    // hardware of the board, drivers of modules can add their devices before boardCheck()
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    int8_t lEeprom = I2cRegistry::add("EEPROM", Wire, I2C_EEPROM_DEVICE_ADDRESSS, I2C_EEPROM_DEVICE_ADDRESSS, nullptr, BOARD_HW_EEPROM);
+#endif
+#ifdef I2C_1WIRE_DEVICE_ADDRESSS
 #if COUNT_1WIRE_BUSMASTER >= 1
 #ifdef SENSORMODULE
-    // check for I2C ack
-    printDebug("Checking 1-Wire existence... ");
-    lWire.beginTransmission(I2C_1WIRE_DEVICE_ADDRESSS);
-    lResult = (lWire.endTransmission() == 0);
-    if (lResult)
-        boardHardware |= BOARD_HW_ONEWIRE;
-    printResult(lResult);
+    I2cRegistry::add("1-Wire", lWire, I2C_1WIRE_DEVICE_ADDRESSS, I2C_1WIRE_DEVICE_ADDRESSS, nullptr, BOARD_HW_ONEWIRE);
 #endif
 #ifdef WIREGATEWAY
-    // check for I2C ack
-    printDebug("Checking 1-Wire existence 0x19 ... ");
-    lWire.beginTransmission(I2C_1WIRE_DEVICE_ADDRESSS + 1);
-    lResult = (lWire.endTransmission() == 0);
-    if (lResult)
-        boardHardware |= BOARD_HW_ONEWIRE;
-    printResult(lResult);
+    I2cRegistry::add("1-Wire 0x19", lWire, I2C_1WIRE_DEVICE_ADDRESSS + 1, I2C_1WIRE_DEVICE_ADDRESSS + 1, nullptr, BOARD_HW_ONEWIRE);
 #endif
 #endif
 #if COUNT_1WIRE_BUSMASTER >= 2
-    // check for I2C ack
-    printDebug("Checking 1-Wire existence 0x1A... ");
-    lWire.beginTransmission(I2C_1WIRE_DEVICE_ADDRESSS + 2);
-    lResult = (lWire.endTransmission() == 0);
-    if (lResult)
-        boardHardware |= BOARD_HW_ONEWIRE;
-    printResult(lResult);
+    I2cRegistry::add("1-Wire 0x1A", lWire, I2C_1WIRE_DEVICE_ADDRESSS + 2, I2C_1WIRE_DEVICE_ADDRESSS + 2, nullptr, BOARD_HW_ONEWIRE);
 #endif
 #if COUNT_1WIRE_BUSMASTER == 3
-    // check for I2C ack
-    printDebug("Checking 1-Wire existence 0x1B... ");
-    lWire.beginTransmission(I2C_1WIRE_DEVICE_ADDRESSS + 3);
-    lResult = (lWire.endTransmission() == 0);
-    if (lResult)
-        boardHardware |= BOARD_HW_ONEWIRE;
-    printResult(lResult);
+    I2cRegistry::add("1-Wire 0x1B", lWire, I2C_1WIRE_DEVICE_ADDRESSS + 3, I2C_1WIRE_DEVICE_ADDRESSS + 3, nullptr, BOARD_HW_ONEWIRE);
 #endif
-    // lWire.end();
 #endif
-
 #ifdef I2C_RGBLED_DEVICE_ADDRESS
-    printDebug("Checking LED driver existence... ");
-    // check for I2C ack
-    Wire.beginTransmission(I2C_RGBLED_DEVICE_ADDRESS);
-    lResult = (Wire.endTransmission() == 0);
-    if (lResult)
-        boardHardware |= BOARD_HW_LED;
-    printResult(lResult);
+    I2cRegistry::add("LED driver", Wire, I2C_RGBLED_DEVICE_ADDRESS, I2C_RGBLED_DEVICE_ADDRESS, nullptr, BOARD_HW_LED);
+#endif
+    // one pass over all registered addresses, the UART probe is processed meanwhile
+    I2cRegistry::scan(false, lCached, Ncn5130::loop);
+#ifdef I2C_EEPROM_DEVICE_ADDRESSS
+    // we rely on EEPROM
+    lResult = I2cRegistry::present(lEeprom);
 #endif
-    // lResult = checkUartExistence();
 #endif // NO_I2C
+    // wait for the end of the UART probe (bounded by its timeout)
+    while (!Ncn5130::idle())
+        Ncn5130::loop();
+#ifdef NO_I2C
+    lResult = boardWithNCN5130();
+#endif
+    BENCHMARK_STOP(boardCheck, lBenchmarkStart, 0);
     return lResult;
 }
 
 bool checkUartExistence()
 {
     printDebug("Checking UART existence...\n");
-    bool lResult = false;
-    initUart();
-    // send system state command and interpret answer
-    uint8_t lResp = sendUartCommand("SYSTEM_STATE", U_SYSTEM_STATE, U_SYSTEM_STAT_IND, 1);
-    lResult = (lResp & 3) == 3;
-    printResult(lResult);
-    if (lResult)
-        boardHardware |= BOARD_HW_NCN5130;
-    return lResult;
+    startUartProbe();
+    while (!Ncn5130::idle())
+        Ncn5130::loop();
+    return boardWithNCN5130();
 }
 
+// the UART is initialized just once, further calls return immediately
 bool initUart() {
-    Serial1.end();
-    delay(100);
-    Serial1.begin(19200, SERIAL_8E1);
-    for (uint16_t lCount = 0; !Serial1 && lCount < 1000; lCount++);
-    if (!Serial1) {
-        printDebug("initUart() failed, something is going completely wrong!");
-        return false;
-    }
-    return true;
+    return Ncn5130::begin();
 }
 
+// blocking version of Ncn5130::send(), returns 0 on timeout
 uint8_t sendUartCommand(const char *iInfo, uint8_t iCmd, uint8_t iResp, uint8_t iLen /* = 0 */)
 {
-    printDebug("    Send command %s (%02X)... ", iInfo, iCmd);
-    // send system state command and interpret answer
-    Serial1.write(iCmd);
-
-    int lResp = 0;
-    uint32_t lUartResponseDelay = millis();
-    while (!delayCheck(lUartResponseDelay, 100))
-    {
-        lResp = Serial1.read();
-        if (lResp == iResp)
-        {
-            printDebug("OK - received expected response (%02X)\n", lResp);
-            if (iLen == 1)
-                lResp = Serial1.read();
-            break;
-        }
-    }
-    return lResp;
+    return Ncn5130::execute(iCmd, iResp, iLen, iInfo);
 }
 
 bool boardWithOneWire()
@@ -361,6 +361,8 @@
 #define FATAL_LOG_WRONG_CHANNEL_COUNT 4  // knxprod contains more channels than logic supports
 #define FATAL_SENS_UNKNOWN            5  // unknown or unsupported sensor
 #define FATAL_SCHEDULE_MAX_CALLBACKS  6  // Too many callbacks in scheduler
+#define FATAL_EEPROM_REGIONS          7  // EEPROM regions overlap or do not fit into EEPROM
+#define FATAL_USERDATA                8  // UserData does not fit into its flash ring
 
 // // EEPROM Support
 // #define I2C_EEPROM_DEVICE_ADDRESSS 0x50 // Address of 24LC256 eeprom chip
@@ -454,9 +456,25 @@ union uData
     sActorInfo actor;
 };
 
+// timeout of the UART probe in boardCheck() in ms, the UART is probed while I2C devices are scanned (see I2cRegistry)
+#ifndef BOARD_PROBE_UART_TIMEOUT
+#define BOARD_PROBE_UART_TIMEOUT 100
+#endif
+// power off time to reset devices blocking the I2C bus in ms
+#ifndef I2C_POWER_CYCLE_TIME
+#define I2C_POWER_CYCLE_TIME 5000
+#endif
+// watchdog scratch register (RP2040) keeping the probe result for an intentional restart
+#define BOARD_PROBE_SCRATCH 0
+#define BOARD_PROBE_MAGIC   0x0B4C2D00
+
 // call this BEFORE Wire.begin()
-// it clears I2C Bus, calls Wire.begin() and checks which board hardware is available
+// it clears I2C Bus, calls Wire.begin() and checks which board hardware is available.
+// After a restart prepared by prepareRestart(), the result of the previous probe is used.
 bool boardCheck();
+// call this right before an intentional restart, the next boardCheck() skips probing. After any other
+// reset (i.e. by watchdog, which might be caused by a hanging device) the board is probed again.
+void prepareRestart();
 bool checkUartExistence();
 bool initUart();
 uint8_t sendUartCommand(const char* iInfo, uint8_t iCmd, uint8_t iResp, uint8_t iLen = 0);
@@ -469,6 +487,15 @@ bool boardWithNCN5130();
 
 void ledInfo(bool iOn);
 void ledProg(bool iOn);
+// maximum time restorePower() waits for the bus voltage to return (SAVE pin high) in ms
+#ifndef RESTORE_POWER_TIMEOUT
+#define RESTORE_POWER_TIMEOUT 500
+#endif
+// time for attached sensors to start after the 5V rail is switched on again in ms
+#ifndef RESTORE_POWER_SETTLE_TIME
+#define RESTORE_POWER_SETTLE_TIME 100
+#endif
+
 // Turn off 5V rail from NCN5130 to save power for EEPROM write during knx save operation
 void savePower();
 // Turn on 5V rail from NCN5130 in case SAVE-Interrupt was false positive
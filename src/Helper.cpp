@@ -1,5 +1,109 @@
 #include "Helper.h"
 
+#ifdef ARDUINO_ARCH_RP2040
+#include <hardware/sync.h>
+#endif
+
+#ifdef OPENKNX_DUALCORE
+// disabling interrupts just protects against the own core, the spinlock protects against the other one
+static spin_lock_t *sCriticalLock = spin_lock_init(spin_lock_claim_unused(true));
+#endif
+
+static char sDebugBuffer[DEBUG_BUFFER_SIZE];
+static volatile uint16_t sDebugHead = 0; // next write position, changed just by producers
+static volatile uint16_t sDebugTail = 0; // next read position, changed just by printDebugLoop()
+static volatile uint16_t sDebugDropped = 0;
+static bool sDebugBuffered = false;
+
+uint32_t enterCritical()
+{
+#if defined(OPENKNX_DUALCORE)
+    return spin_lock_blocking(sCriticalLock);
+#elif defined(ARDUINO_ARCH_RP2040)
+    return save_and_disable_interrupts();
+#elif defined(__ARM_ARCH)
+    uint32_t lState = __get_PRIMASK();
+    __disable_irq();
+    return lState;
+#else
+    noInterrupts();
+    return 0;
+#endif
+}
+
+void exitCritical(uint32_t iState)
+{
+#if defined(OPENKNX_DUALCORE)
+    spin_unlock(sCriticalLock, iState);
+#elif defined(ARDUINO_ARCH_RP2040)
+    restore_interrupts(iState);
+#elif defined(__ARM_ARCH)
+    __set_PRIMASK(iState);
+#else
+    (void)iState;
+    interrupts();
+#endif
+}
+
+// messages are stored completely or dropped, there are no partial messages in buffer
+static void pushDebug(const char *iText, uint16_t iLength)
+{
+    uint32_t lState = enterCritical();
+    uint16_t lFree = (sDebugTail + DEBUG_BUFFER_SIZE - sDebugHead - 1) % DEBUG_BUFFER_SIZE;
+    if (iLength > lFree)
+        sDebugDropped++;
+    else
+    {
+        uint16_t lHead = sDebugHead;
+        uint16_t lFirst = DEBUG_BUFFER_SIZE - lHead;
+        if (lFirst > iLength)
+            lFirst = iLength;
+        memcpy(sDebugBuffer + lHead, iText, lFirst);
+        memcpy(sDebugBuffer, iText + lFirst, iLength - lFirst);
+        sDebugHead = (lHead + iLength) % DEBUG_BUFFER_SIZE;
+    }
+    exitCritical(lState);
+}
+
+void pushDebugData(const uint8_t *iData, uint16_t iLength)
+{
+    if (!sDebugBuffered)
+        SERIAL_DEBUG.write(iData, iLength);
+    else
+        pushDebug((const char *)iData, iLength);
+}
+
+// sends buffered output, just as much as fits into the serial send buffer if iBlocking is false
+static void sendDebug(bool iBlocking)
+{
+    if (sDebugDropped > 0)
+    {
+        uint32_t lState = enterCritical();
+        uint16_t lDropped = sDebugDropped;
+        sDebugDropped = 0;
+        exitCritical(lState);
+        char lBuffer[40];
+        snprintf(lBuffer, 40, "\n[%u debug messages dropped]\n", lDropped);
+        pushDebug(lBuffer, strlen(lBuffer));
+    }
+    uint16_t lHead = sDebugHead;
+    while (sDebugTail != lHead)
+    {
+        uint16_t lTail = sDebugTail;
+        size_t lChunk = (lHead > lTail) ? lHead - lTail : DEBUG_BUFFER_SIZE - lTail;
+        if (!iBlocking)
+        {
+            size_t lSpace = SERIAL_DEBUG.availableForWrite();
+            if (lSpace == 0)
+                break;
+            if (lChunk > lSpace)
+                lChunk = lSpace;
+        }
+        SERIAL_DEBUG.write((const uint8_t *)sDebugBuffer + lTail, lChunk);
+        sDebugTail = (lTail + lChunk) % DEBUG_BUFFER_SIZE;
+    }
+}
+
 // generic helper for formatted debug output
 int printDebug(const char *format, ...)
 {
@@ -8,24 +112,36 @@ int printDebug(const char *format, ...)
     va_start(args, format);
     int lResult = vsnprintf(buffer, 256, format, args);
     va_end(args);
-    SERIAL_DEBUG.print(buffer);
+    if (!sDebugBuffered)
+        SERIAL_DEBUG.print(buffer);
+    else if (lResult > 0)
+        pushDebug(buffer, lResult < 256 ? lResult : 255);
     return lResult;
 }
 
 void printHEX(const char* iPrefix, const uint8_t *iData, size_t iLength)
 {
-    SERIAL_DEBUG.print(iPrefix);
-    for (size_t i = 0; i < iLength; i++) {
-        if (iData[i] < 0x10) { SERIAL_DEBUG.print("0"); }
-        SERIAL_DEBUG.print(iData[i], HEX);
-        SERIAL_DEBUG.print(" ");
-    }
-    SERIAL_DEBUG.println();
+    printDebug("%s", iPrefix);
+    for (size_t i = 0; i < iLength; i++)
+        printDebug("%02X ", iData[i]);
+    printDebug("\n");
 }
 
 void printResult(bool iResult)
 {
-    SERIAL_DEBUG.println(iResult ? "OK" : "FAIL");
+    printDebug("%s\n", iResult ? "OK" : "FAIL");
+}
+
+void printDebugLoop()
+{
+    // from now on, debug output is buffered
+    sDebugBuffered = true;
+    sendDebug(false);
+}
+
+void printDebugFlush()
+{
+    sendDebug(true);
 }
 
 // ensure correct time delta check
@@ -46,4 +162,15 @@ uint32_t delayTimerInit()
 // check if a float is a number (false if Not-a-number)
 bool isNum(float iNumber) {
     return (iNumber + 10.0) > NO_NUM;
+}
+
+uint16_t crc16(const uint8_t *iData, size_t iLength, uint16_t iCrc /* = 0xFFFF */)
+{
+    for (size_t i = 0; i < iLength; i++)
+    {
+        iCrc ^= (uint16_t)iData[i] << 8;
+        for (uint8_t lBit = 0; lBit < 8; lBit++)
+            iCrc = (iCrc & 0x8000) ? (iCrc << 1) ^ 0x1021 : iCrc << 1;
+    }
+    return iCrc;
 }
\ No newline at end of file
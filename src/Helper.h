@@ -11,15 +11,69 @@
  * Helper for any module
  * *******************/
 
+// Debug output is collected in a ring buffer and sent to SERIAL_DEBUG from printDebugLoop(), 
+// so printing costs no serial transfer time and is safe in interrupt handlers.
+// Output before the first call of printDebugLoop() (during setup) is printed synchronously.
+// If the buffer is full, messages are dropped and the number of dropped messages is printed later.
+#ifndef DEBUG_BUFFER_SIZE
+#define DEBUG_BUFFER_SIZE 1024
+#endif
+
+// compile time log levels, calls above LOG_LEVEL compile to nothing.
+// With LOG_DEFERRED, log calls write binary frames to be decoded on the host (see DeferredLog.h)
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#ifdef LOG_DEFERRED
+#include "DeferredLog.h"
+#define LOG_PRINT(format, ...) printDeferred(DEFERRED_LOG_FORMAT(format), ##__VA_ARGS__)
+#else
+#define LOG_PRINT(...) printDebug(__VA_ARGS__)
+#endif
+// disabled calls are a statement, which uses its arguments without evaluating them (no empty if, no unused variables)
+#define LOG_DISABLED(...) do { if (0) printDebug(__VA_ARGS__); } while (0)
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_PRINT(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_PRINT(__VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_PRINT(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
 // generic helper for formatted debug output
 int printDebug(const char *format, ...);
 void printHEX(const char* iPrefix, const uint8_t *iData, size_t iLength);
 void printResult(bool iResult);
+// raw data for debug output, i.e. frames of deferred logging
+void pushDebugData(const uint8_t *iData, uint16_t iLength);
+// send buffered debug output without blocking, call this in loop()
+void printDebugLoop();
+// send all buffered debug output, blocks until done (i.e. before restart)
+void printDebugFlush();
+
+// short critical section, can be used in interrupt handlers
+// with OPENKNX_DUALCORE it locks out the other core as well and must not be nested
+uint32_t enterCritical();
+void exitCritical(uint32_t iState);
 
 // ensure correct time delta check
-// cannot be used in interrupt handler
+// cannot be used in interrupt handler, new code should use Deadline or TimerWheel (TimerWheel.h)
 bool delayCheck(uint32_t iOldTimer, uint32_t iDuration);
 // init delay timer with millis, ensure that it is not 0
 uint32_t delayTimerInit();
 // check for float number
-bool isNum(float iNumber);
\ No newline at end of file
+bool isNum(float iNumber);
+// CRC-16/CCITT, pass the result of a previous call as iCrc to calculate the checksum in chunks
+uint16_t crc16(const uint8_t *iData, size_t iLength, uint16_t iCrc = 0xFFFF);
\ No newline at end of file
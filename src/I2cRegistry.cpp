@@ -0,0 +1,178 @@
+#include "I2cRegistry.h"
+#include "Helper.h"
+
+#ifdef OPENKNX_DUALCORE
+#include <pico/mutex.h>
+
+auto_init_recursive_mutex(sI2cMutex);
+
+I2cLock::I2cLock()
+{
+    recursive_mutex_enter_blocking(&sI2cMutex);
+}
+
+I2cLock::~I2cLock()
+{
+    recursive_mutex_exit(&sI2cMutex);
+}
+
+void I2cLock::acquire()
+{
+    recursive_mutex_enter_blocking(&sI2cMutex);
+}
+
+void I2cLock::release()
+{
+    recursive_mutex_exit(&sI2cMutex);
+}
+#endif
+
+extern uint8_t boardHardware;
+
+I2cRegistry::sDriver I2cRegistry::sDrivers[I2C_REGISTRY_MAX_DRIVERS];
+uint8_t I2cRegistry::sDriverCount = 0;
+TwoWire *I2cRegistry::sBuses[I2C_REGISTRY_BUSES];
+uint8_t I2cRegistry::sAddresses[I2C_REGISTRY_BUSES][128];
+
+int8_t I2cRegistry::busIndex(TwoWire &iWire, bool iAdd)
+{
+    for (uint8_t lBus = 0; lBus < I2C_REGISTRY_BUSES; lBus++)
+    {
+        if (sBuses[lBus] == &iWire)
+            return lBus;
+        if (sBuses[lBus] == nullptr && iAdd)
+        {
+            sBuses[lBus] = &iWire;
+            return lBus;
+        }
+    }
+    return -1;
+}
+
+int8_t I2cRegistry::add(const char *iName, TwoWire &iWire, uint8_t iFirstAddress, uint8_t iLastAddress,
+                        I2cProbe iProbe /* = nullptr */, uint8_t iBoardFlag /* = 0 */)
+{
+    int8_t lBus = busIndex(iWire, true);
+    if (lBus < 0 || sDriverCount >= I2C_REGISTRY_MAX_DRIVERS || iFirstAddress > iLastAddress || iLastAddress > 0x7F)
+    {
+        LOG_ERROR("I2cRegistry: %s can not be registered\n", iName);
+        return -1;
+    }
+    for (uint8_t lAddress = iFirstAddress; lAddress <= iLastAddress; lAddress++)
+    {
+        if ((sAddresses[lBus][lAddress] & 0x7F) != 0)
+        {
+            LOG_ERROR("I2cRegistry: %s uses address 0x%02X of %s\n", iName, lAddress, sDrivers[(sAddresses[lBus][lAddress] & 0x7F) - 1].name);
+            return -1;
+        }
+    }
+    sDriver &lDriver = sDrivers[sDriverCount];
+    lDriver.name = iName;
+    lDriver.wire = &iWire;
+    lDriver.firstAddress = iFirstAddress;
+    lDriver.lastAddress = iLastAddress;
+    lDriver.foundAddress = 0;
+    lDriver.boardFlag = iBoardFlag;
+    lDriver.probe = iProbe;
+    sDriverCount++;
+    for (uint8_t lAddress = iFirstAddress; lAddress <= iLastAddress; lAddress++)
+        sAddresses[lBus][lAddress] = sDriverCount;
+    return sDriverCount - 1;
+}
+
+// the time check classifies slow answers as missing, it does not shorten the transaction
+bool I2cRegistry::ping(TwoWire &iWire, uint8_t iAddress)
+{
+    uint32_t lStart = micros();
+    iWire.beginTransmission(iAddress);
+    return (iWire.endTransmission() == 0) && (micros() - lStart < I2C_REGISTRY_TIMEOUT * 1000);
+}
+
+// boardHardware tells just, if any device of a flag was found. This identifies the device (and its address)
+// just for the only driver of a flag with a single address, all other drivers are probed again.
+bool I2cRegistry::cachedByFlag(uint8_t iIndex)
+{
+    sDriver &lDriver = sDrivers[iIndex];
+    if (lDriver.boardFlag == 0 || lDriver.firstAddress != lDriver.lastAddress)
+        return false;
+    for (uint8_t lIndex = 0; lIndex < sDriverCount; lIndex++)
+        if (lIndex != iIndex && (sDrivers[lIndex].boardFlag & lDriver.boardFlag))
+            return false;
+    return true;
+}
+
+void I2cRegistry::scan(bool iFullScan /* = false */, bool iSkipBoardDevices /* = false */, void (*iYield)() /* = nullptr */)
+{
+    for (uint8_t lIndex = 0; lIndex < sDriverCount; lIndex++)
+        sDrivers[lIndex].foundAddress = 0;
+    for (uint8_t lBus = 0; lBus < I2C_REGISTRY_BUSES && sBuses[lBus]; lBus++)
+    {
+        TwoWire &lWire = *sBuses[lBus];
+        // scan() may run on core 1 as well, i.e. as a task of ioScheduler()
+        I2cLock lLock;
+#ifdef ARDUINO_ARCH_RP2040
+        // the core aborts transactions after its timeout, so a device holding the bus does not block the scan
+        unsigned long lTimeout = lWire.getTimeout();
+        lWire.setTimeout(I2C_REGISTRY_TIMEOUT);
+#endif
+        // reserved addresses are not probed
+        for (uint8_t lAddress = 0x08; lAddress < 0x78; lAddress++)
+        {
+            uint8_t lIndex = sAddresses[lBus][lAddress] & 0x7F;
+            if (lIndex == 0 && !iFullScan)
+                continue;
+            sDriver *lDriver = lIndex ? &sDrivers[lIndex - 1] : nullptr;
+            bool lPresent;
+            if (lDriver && iSkipBoardDevices && cachedByFlag(lIndex - 1))
+                lPresent = (boardHardware & lDriver->boardFlag);
+            else
+            {
+                if (lDriver)
+                    printDebug("Checking %s existence (0x%02X)... ", lDriver->name, lAddress);
+                lPresent = ping(lWire, lAddress);
+                if (lPresent && lDriver && lDriver->probe)
+                    lPresent = lDriver->probe(lWire, lAddress);
+                if (lDriver)
+                    printResult(lPresent);
+                if (iYield)
+                    iYield();
+            }
+            sAddresses[lBus][lAddress] = lIndex | (lPresent ? 0x80 : 0);
+            if (lPresent && lDriver && lDriver->foundAddress == 0)
+            {
+                lDriver->foundAddress = lAddress;
+                boardHardware |= lDriver->boardFlag;
+            }
+        }
+#ifdef ARDUINO_ARCH_RP2040
+        lWire.setTimeout(lTimeout);
+#endif
+    }
+}
+
+bool I2cRegistry::present(int8_t iHandle)
+{
+    return address(iHandle) != 0;
+}
+
+uint8_t I2cRegistry::address(int8_t iHandle)
+{
+    return (iHandle >= 0 && iHandle < sDriverCount) ? sDrivers[iHandle].foundAddress : 0;
+}
+
+bool I2cRegistry::present(TwoWire &iWire, uint8_t iAddress)
+{
+    int8_t lBus = busIndex(iWire, false);
+    return lBus >= 0 && iAddress < 0x80 && (sAddresses[lBus][iAddress] & 0x80);
+}
+
+void I2cRegistry::print()
+{
+    for (uint8_t lBus = 0; lBus < I2C_REGISTRY_BUSES && sBuses[lBus]; lBus++)
+        for (uint8_t lAddress = 0; lAddress < 0x80; lAddress++)
+        {
+            uint8_t lEntry = sAddresses[lBus][lAddress];
+            if (lEntry & 0x80)
+                printDebug("I2C bus %d, 0x%02X: %s\n", lBus, lAddress, (lEntry & 0x7F) ? sDrivers[(lEntry & 0x7F) - 1].name : "unknown device");
+        }
+}
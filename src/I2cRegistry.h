@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include <Wire.h>
+
+/*********************************************
+ * Registry of I2C devices
+ *
+ * Drivers register the address range of their
+ * device (and optionally a probe function to
+ * verify it) before scan(). The scan probes
+ * each address just once, afterwards lookups
+ * by handle or address are O(1).
+ * *******************************************/
+// maximum number of registered drivers
+#ifndef I2C_REGISTRY_MAX_DRIVERS
+#define I2C_REGISTRY_MAX_DRIVERS 16
+#endif
+// maximum number of I2C buses (Wire, Wire1)
+#ifndef I2C_REGISTRY_BUSES
+#define I2C_REGISTRY_BUSES 2
+#endif
+// a device, which does not answer within this time (ms), is treated as missing. On RP2040 this is the
+// timeout of the Wire transaction during scan(), so it bounds the time of each probe. Other cores have no
+// transaction timeout, there a probe might block longer and is just treated as missing afterwards.
+#ifndef I2C_REGISTRY_TIMEOUT
+#define I2C_REGISTRY_TIMEOUT 10
+#endif
+
+// called for an answering address of a driver, returns true, if it is the expected device (i.e. by an id register)
+typedef bool (*I2cProbe)(TwoWire &iWire, uint8_t iAddress);
+
+class I2cRegistry
+{
+  private:
+    struct sDriver
+    {
+        const char *name;
+        TwoWire *wire;
+        uint8_t firstAddress;
+        uint8_t lastAddress;
+        uint8_t foundAddress; // first present address, 0 if there is none
+        uint8_t boardFlag;
+        I2cProbe probe;
+    };
+
+    static sDriver sDrivers[I2C_REGISTRY_MAX_DRIVERS];
+    static uint8_t sDriverCount;
+    static TwoWire *sBuses[I2C_REGISTRY_BUSES];
+    // per bus and address: index of the driver + 1 (0 for none), bit 7 is set if the device is present
+    static uint8_t sAddresses[I2C_REGISTRY_BUSES][128];
+
+    static int8_t busIndex(TwoWire &iWire, bool iAdd);
+    static bool ping(TwoWire &iWire, uint8_t iAddress);
+    static bool cachedByFlag(uint8_t iIndex);
+
+  public:
+    // Registers a driver for the addresses iFirstAddress to iLastAddress on iWire. With iBoardFlag, a present
+    // device is also added to boardHardware (BOARD_HW_*). Returns the handle of the driver, -1 if the table is
+    // full or an address is registered already.
+    static int8_t add(const char *iName, TwoWire &iWire, uint8_t iFirstAddress, uint8_t iLastAddress,
+                      I2cProbe iProbe = nullptr, uint8_t iBoardFlag = 0);
+    // Probes each registered address once. With iFullScan, unregistered addresses are probed as well.
+    // With iSkipBoardDevices, drivers with board flag are taken from boardHardware instead of probing them, as long
+    // as the flag identifies the device: drivers sharing their flag or with an address range are probed anyway.
+    // iYield (optional) is called after each probe, i.e. to process other I/O meanwhile.
+    static void scan(bool iFullScan = false, bool iSkipBoardDevices = false, void (*iYield)() = nullptr);
+    // true, if a device of the driver was found by scan()
+    static bool present(int8_t iHandle);
+    // first present address of the driver, 0 if there is none
+    static uint8_t address(int8_t iHandle);
+    // true, if any device answered at iAddress during scan()
+    static bool present(TwoWire &iWire, uint8_t iAddress);
+    // prints all present devices
+    static void print();
+};
+
+/*********************************************
+ * Lock of the I2C buses
+ *
+ * With OPENKNX_DUALCORE both cores access I2C
+ * devices. Core 0 holds the lock from its first
+ * loop() on and lends it to core 1 just during
+ * knx.loop(), so drivers and modules on core 0
+ * need no lock. Code on core 1 and callbacks
+ * of group objects (they run in knx.loop()
+ * without the lock, this is not checked) have
+ * to protect each transaction (or a sequence,
+ * which has to be atomic) by an instance of
+ * I2cLock on the stack. The lock is recursive.
+ * Without OPENKNX_DUALCORE it does nothing.
+ * *******************************************/
+class I2cLock
+{
+  public:
+#ifdef OPENKNX_DUALCORE
+    I2cLock();
+    ~I2cLock();
+    I2cLock(const I2cLock &) = delete;
+    I2cLock &operator=(const I2cLock &) = delete;
+
+    // core 0 takes and lends the lock, called by OpenKNXfacade::loop()
+    static void acquire();
+    static void release();
+#else
+    I2cLock() {}
+
+    static void acquire() {}
+    static void release() {}
+#endif
+};
@@ -1,5 +1,8 @@
 #pragma once
 #include <stdint.h>
+#include "FlashUserDataView.h"
+#include "FlashUserDataWriter.h"
+#include "FlashUserDataRing.h"
 
 /**
  * Interface for classes that can save and restore data to/from Flash memory. 
@@ -20,6 +23,31 @@ class IFlashUserData
         return buffer;
     }
     
+    /**
+     * Optional streaming save: The object writes its state to the writer, which flushes it in small chunks to flash.
+     * Objects with large state should use this, because save(buffer) needs a buffer of saveSize() bytes in RAM.
+     * The writer accepts at most saveSize() bytes. Just called if streamsSave() returns true, otherwise save(buffer) is used.
+     *
+     * @param writer The writer the object should save its state to.
+     *
+     * @return true, if the state was written to the writer. The default implementation returns false.
+     */
+    virtual bool saveStream(FlashUserDataWriter& /* writer */)
+    {
+        return false;
+    }
+
+    /**
+     * Override this together with saveStream(). The buffer for save(buffer) is allocated once during startup for
+     * the largest object without streaming support, so nothing is allocated during a SAVE-Interrupt.
+     *
+     * @return true, if the object saves its state by saveStream(). Default is false.
+     */
+    virtual bool streamsSave()
+    {
+        return false;
+    }
+
     /**
      * This method is called when the object should restore its state from the buffer.
      *  
@@ -33,6 +61,33 @@ class IFlashUserData
         return buffer;
     }
     
+    /**
+     * Optional zero copy restore: The object gets a view of its record in memory-mapped flash instead of a buffer
+     * to copy from. The object may keep pointers into the view for read-only state, but has to replace them
+     * whenever restoreView() or relocateView() is called: each save writes a new generation of user data to
+     * another place in flash. After a save, restoreView() is called just if the record was written by this save.
+     *
+     * @param view Read-only, bounds-checked view of the data written by the last save().
+     *
+     * @return true, if the view was used. restore(buffer) is not called then.
+     * The default implementation returns false, so restore(buffer) is called.
+     */
+    virtual bool restoreView(const FlashUserDataView& /* view */)
+    {
+        return false;
+    }
+
+    /**
+     * Called after a save, which copied the unchanged (or, if the save budget was exhausted, the previous) record
+     * of the object to the new generation. The record contains the state of the last save, which might be older
+     * than the state in RAM, so do not restore from it, just replace pointers into the old view.
+     *
+     * @param view Read-only, bounds-checked view of the copied record. The default implementation does nothing.
+     */
+    virtual void relocateView(const FlashUserDataView& /* view */)
+    {
+    }
+
     /**
      * This method is used to calculate maximum needed buffer size for SAVE processing
      * 
@@ -43,6 +98,67 @@ class IFlashUserData
         return 0;
     }
 
+    /**
+     * Each object is stored in its own record in flash, identified by id(). The record is found independent of
+     * the order of objects in chain, so the id has to be unique and stable between firmware versions.
+     * Objects without id (0 or a reserved id from 0xFF00) are stored by their position in chain, like in the old
+     * format, so their record is lost if the chain changes. Duplicate ids are a fatal error.
+     * 
+     * @return The id of the record. The default 0 means "no id".
+     */
+    virtual uint16_t id()
+    {
+        return USERDATA_RECORD_NONE;
+    }
+
+    /**
+     * The version is stored with each record. A record is just restored if its version is the same as the
+     * version of the object, otherwise the object keeps its defaults. Increase the version whenever the
+     * format written by save() changes.
+     * 
+     * @return The version of the data format written by save().
+     */
+    virtual uint8_t version()
+    {
+        return 0;
+    }
+
+    /**
+     * This method is called during SAVE processing to find out, if the object state changed since the last save().
+     * If the object is not dirty, it is not serialized again, its record already in flash is kept as is.
+     * The default implementation returns always true, so the object is saved each time (full save).
+     * If you override this, reset your dirty flag in save().
+     *
+     * @return true, if the object state changed since the last call to save().
+     */
+    virtual bool isDirty()
+    {
+        return true;
+    }
+
+
+    /**
+     * During SAVE-Interrupt processing there is just a limited time until power is lost. Records are written in 
+     * order of descending priority, so the most important data is committed first.
+     * 
+     * @return The priority of the object, higher values are saved first. Default is 0.
+     */
+    virtual uint8_t savePriority()
+    {
+        return 0;
+    }
+
+    /**
+     * This method is used to decide, if the object can be saved within the remaining time budget of a 
+     * SAVE-Interrupt, as long as there is no measured save duration of the object.
+     * After the first save, the measured duration is used instead.
+     * 
+     * @return The estimated time in microseconds the object needs to save its state. Default is 0.
+     */
+    virtual uint32_t saveCost()
+    {
+        return 0;
+    }
 
     /**
      * This method is called to fetch the next IFlashUserData class, which wants to persist data
@@ -105,5 +221,10 @@ class IFlashUserData
     }
 
   private:
+    friend class FlashUserData;
     IFlashUserData* _next = 0;
+    uint16_t _recordId = USERDATA_RECORD_NONE; // id() or the id derived from position in chain, set by readFlash()
+    uint32_t _saveDuration = 0; // measured duration of last save in microseconds
+    bool _recordChanged = false; // record differs from the state in RAM, kept until the record is written
+    bool _recordWritten = false; // record was written by the current save, not copied
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "LoopStats.h"
+#include "Helper.h"
+
+LoopHistogram LoopStats::sStages[StageCount];
+uint32_t LoopStats::sLoopStart = 0;
+uint32_t LoopStats::sStageStart = 0;
+uint32_t LoopStats::sMaxTotal = 0;
+bool LoopStats::sStarted = false;
+
+void LoopHistogram::add(uint32_t iMicros)
+{
+    // bucket n counts durations below 2^n us, 0 is counted in bucket 0
+    uint8_t lBucket = iMicros ? 32 - __builtin_clz(iMicros) : 0;
+    if (lBucket >= LOOPSTATS_BUCKETS)
+        lBucket = LOOPSTATS_BUCKETS - 1;
+    _buckets[lBucket]++;
+    if (_count == 0 || iMicros < _min)
+        _min = iMicros;
+    if (iMicros > _max)
+        _max = iMicros;
+    _sum += iMicros;
+    _count++;
+}
+
+uint32_t LoopHistogram::percentile(uint8_t iPercent)
+{
+    uint64_t lLimit = ((uint64_t)_count * iPercent + 99) / 100;
+    uint64_t lSum = 0;
+    for (uint8_t lBucket = 0; lBucket < LOOPSTATS_BUCKETS; lBucket++)
+    {
+        lSum += _buckets[lBucket];
+        if (lSum >= lLimit)
+        {
+            uint32_t lBound = (lBucket < 32) ? (1UL << lBucket) : 0xFFFFFFFF;
+            return (lBound < _max) ? lBound : _max;
+        }
+    }
+    return _max;
+}
+
+void LoopHistogram::print(const char *iName)
+{
+    if (_count == 0)
+    {
+        printDebug("%-14s no data\n", iName);
+        return;
+    }
+    printDebug("%-14s %8lu x  min %7lu  avg %7lu  p50 %7lu  p99 %7lu  max %7lu us\n", iName,
+               (unsigned long)_count, (unsigned long)_min, (unsigned long)(_sum / _count),
+               (unsigned long)percentile(50), (unsigned long)percentile(99), (unsigned long)_max);
+}
+
+void LoopHistogram::reset()
+{
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _min = 0;
+    _max = 0;
+    _sum = 0;
+}
+
+void LoopStats::begin()
+{
+    uint32_t lNow = micros();
+    if (sStarted)
+    {
+        uint32_t lTotal = lNow - sLoopStart;
+        sStages[StageModules].add(lNow - sStageStart);
+        sStages[StageTotal].add(lTotal);
+        if (lTotal > sMaxTotal)
+            sMaxTotal = lTotal;
+    }
+    sStarted = true;
+    sLoopStart = lNow;
+    sStageStart = lNow;
+}
+
+void LoopStats::end(eStage iStage)
+{
+    uint32_t lNow = micros();
+    sStages[iStage].add(lNow - sStageStart);
+    sStageStart = lNow;
+}
+
+uint32_t LoopStats::takeMaxTotal()
+{
+    uint32_t lMax = sMaxTotal;
+    sMaxTotal = 0;
+    return lMax;
+}
+
+void LoopStats::print()
+{
+    // percentiles are upper bounds of the histogram buckets, so they are exact just to a factor of 2
+    static const char *sNames[StageCount] = {"FlashUserData", "knx.loop", "EEPROM", "NCN5130", "scheduler",
+                                             "ioScheduler", "debug output", "modules", "total"};
+    printDebug("Loop statistics:\n");
+    for (uint8_t lStage = 0; lStage < StageCount; lStage++)
+        sStages[lStage].print(sNames[lStage]);
+}
+
+void LoopStats::reset()
+{
+    for (uint8_t lStage = 0; lStage < StageCount; lStage++)
+        sStages[lStage].reset();
+    sMaxTotal = 0;
+    sStarted = false;
+}
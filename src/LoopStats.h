@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+
+/*********************************************
+ * Duration of the stages of OpenKNXfacade::loop
+ *
+ * Define OPENKNX_LOOPSTATS to collect the
+ * duration of each stage of loop() in a
+ * histogram with logarithmic buckets (bucket n
+ * counts durations below 2^n us), so memory is
+ * fixed and percentiles can be estimated.
+ * "modules" is the time spent outside of loop()
+ * (the application and its modules), "total"
+ * the time of a complete iteration.
+ * Results are printed with LoopStats::print()
+ * (openknx.printLoopStats()). Without
+ * OPENKNX_LOOPSTATS everything compiles to
+ * nothing.
+ * *******************************************/
+// number of buckets, the last one counts all durations above 2^(n-2) us
+#ifndef LOOPSTATS_BUCKETS
+#define LOOPSTATS_BUCKETS 24
+#endif
+
+#ifdef OPENKNX_LOOPSTATS
+#define LOOPSTATS_BEGIN() LoopStats::begin()
+#define LOOPSTATS_STAGE(stage) LoopStats::end(LoopStats::stage)
+#else
+#define LOOPSTATS_BEGIN()
+#define LOOPSTATS_STAGE(stage)
+#endif
+
+// histogram of durations with min/avg/max
+class LoopHistogram
+{
+  public:
+    void add(uint32_t iMicros);
+    // upper bound of the bucket containing the given percentile (0-100), limited to max
+    uint32_t percentile(uint8_t iPercent);
+    void print(const char *iName);
+    void reset();
+
+  private:
+    uint32_t _buckets[LOOPSTATS_BUCKETS] = {};
+    uint32_t _count = 0;
+    uint32_t _min = 0;
+    uint32_t _max = 0;
+    uint64_t _sum = 0;
+};
+
+class LoopStats
+{
+  public:
+    enum eStage
+    {
+        StageFlash,
+        StageKnx,
+        StageEeprom,
+        StageNcn5130,
+        StageScheduler,
+        StageIoScheduler,
+        StageDebug,
+        StageModules,
+        StageTotal,
+        StageCount
+    };
+
+    // called at start of loop(), records the time since the end of the last loop() as StageModules
+    static void begin();
+    // records the time since the end of the previous stage
+    static void end(eStage iStage);
+    // maximum duration of a complete iteration since the last call, i.e. for a diagnostic object
+    static uint32_t takeMaxTotal();
+    static void print();
+    static void reset();
+
+  private:
+    static LoopHistogram sStages[StageCount];
+    static uint32_t sLoopStart;
+    static uint32_t sStageStart;
+    static uint32_t sMaxTotal;
+    static bool sStarted;
+};
@@ -0,0 +1,142 @@
+#include "Ncn5130.h"
+#include "Helper.h"
+
+Ncn5130::sCommand Ncn5130::sQueue[NCN5130_QUEUE_SIZE];
+uint8_t Ncn5130::sQueueHead = 0;
+uint8_t Ncn5130::sQueueCount = 0;
+Ncn5130::eState Ncn5130::sState = Ncn5130::Idle;
+uint32_t Ncn5130::sCommandStart = 0;
+bool Ncn5130::sUartInitialized = false;
+
+bool Ncn5130::begin(bool iForce /* = false */)
+{
+    if (sUartInitialized && !iForce)
+        return true;
+    if (sUartInitialized)
+    {
+        Serial1.end();
+        delay(100);
+    }
+    Serial1.begin(19200, SERIAL_8E1);
+    for (uint16_t lCount = 0; !Serial1 && lCount < 1000; lCount++);
+    if (!Serial1) {
+        LOG_ERROR("initUart() failed, something is going completely wrong!");
+        return false;
+    }
+    sUartInitialized = true;
+    return true;
+}
+
+bool Ncn5130::send(const uint8_t *iData, uint8_t iLength, uint8_t iResponse, uint8_t iResponseLength /* = 0 */,
+                   Ncn5130Callback iCallback /* = nullptr */, const char *iInfo /* = nullptr */, uint16_t iTimeout /* = NCN5130_TIMEOUT */)
+{
+    if (sQueueCount >= NCN5130_QUEUE_SIZE || iLength == 0 || iLength > sizeof(sCommand::data))
+        return false;
+    sCommand &lCommand = sQueue[(sQueueHead + sQueueCount) % NCN5130_QUEUE_SIZE];
+    memcpy(lCommand.data, iData, iLength);
+    lCommand.length = iLength;
+    lCommand.response = iResponse;
+    lCommand.responseLength = iResponseLength;
+    lCommand.timeout = iTimeout;
+    lCommand.callback = iCallback;
+    lCommand.info = iInfo;
+    sQueueCount++;
+    // the first command is sent immediately
+    if (sState == Idle)
+        startCommand();
+    return true;
+}
+
+bool Ncn5130::send(uint8_t iCmd, uint8_t iResponse, uint8_t iResponseLength /* = 0 */, Ncn5130Callback iCallback /* = nullptr */,
+                   const char *iInfo /* = nullptr */, uint16_t iTimeout /* = NCN5130_TIMEOUT */)
+{
+    return send(&iCmd, 1, iResponse, iResponseLength, iCallback, iInfo, iTimeout);
+}
+
+// A running command keeps waiting for its response, the UART transmits both commands in sequence
+void Ncn5130::sendImmediate(const uint8_t *iData, uint8_t iLength)
+{
+    Serial1.write(iData, iLength);
+}
+
+// result of execute(), set by its callback
+static bool sExecuted = false;
+static uint8_t sExecuteResult = 0;
+
+static void onExecuted(bool iSuccess, uint8_t /* iResponse */, uint8_t iData)
+{
+    sExecuted = true;
+    sExecuteResult = iSuccess ? iData : 0;
+}
+
+uint8_t Ncn5130::execute(uint8_t iCmd, uint8_t iResponse, uint8_t iResponseLength /* = 0 */, const char *iInfo /* = nullptr */,
+                         uint16_t iTimeout /* = NCN5130_TIMEOUT */)
+{
+    sExecuted = false;
+    while (!send(iCmd, iResponse, iResponseLength, onExecuted, iInfo, iTimeout))
+        loop();
+    while (!sExecuted)
+        loop();
+    return sExecuteResult;
+}
+
+void Ncn5130::startCommand()
+{
+    sCommand &lCommand = sQueue[sQueueHead];
+    // drop stale bytes, they belong to no command
+    while (Serial1.available())
+        Serial1.read();
+    if (lCommand.info)
+        LOG_DEBUG("    Send command %s (%02X)...\n", lCommand.info, lCommand.data[0]);
+    Serial1.write(lCommand.data, lCommand.length);
+    sCommandStart = millis();
+    sState = WaitResponse;
+    if (lCommand.response == NCN5130_NO_RESPONSE)
+        finishCommand(true, 0);
+}
+
+void Ncn5130::finishCommand(bool iSuccess, uint8_t iData)
+{
+    sCommand lCommand = sQueue[sQueueHead];
+    sQueueHead = (sQueueHead + 1) % NCN5130_QUEUE_SIZE;
+    sQueueCount--;
+    sState = Idle;
+    if (lCommand.info && lCommand.response != NCN5130_NO_RESPONSE)
+    {
+        if (iSuccess)
+            LOG_DEBUG("    %s: OK - received expected response (%02X)\n", lCommand.info, lCommand.response);
+        else
+            LOG_DEBUG("    %s: no response within %d ms\n", lCommand.info, lCommand.timeout);
+    }
+    // the callback may queue further commands
+    if (lCommand.callback)
+        lCommand.callback(iSuccess, lCommand.response, lCommand.responseLength ? iData : lCommand.response);
+    if (sState == Idle && sQueueCount > 0)
+        startCommand();
+}
+
+bool Ncn5130::idle()
+{
+    return sState == Idle && sQueueCount == 0;
+}
+
+void Ncn5130::loop()
+{
+    while (sState != Idle && Serial1.available())
+    {
+        sCommand &lCommand = sQueue[sQueueHead];
+        uint8_t lByte = Serial1.read();
+        if (sState == WaitData)
+            finishCommand(true, lByte);
+        // other indications are ignored while waiting for the response
+        else if (lByte == lCommand.response)
+        {
+            if (lCommand.responseLength == 0)
+                finishCommand(true, 0);
+            else
+                sState = WaitData;
+        }
+    }
+    if (sState != Idle && delayCheck(sCommandStart, sQueue[sQueueHead].timeout))
+        finishCommand(false, 0);
+}
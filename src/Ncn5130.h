@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+
+/*********************************************
+ * Non-blocking engine for NCN5130 control
+ * services on the KNX UART (Serial1)
+ *
+ * Commands are queued and sent one after the
+ * other from loop(). Each command waits for its
+ * expected indication (and optional data byte)
+ * until its timeout, then its callback is
+ * called. The UART is initialized just once.
+ *
+ * While the knx stack is running, it reads the
+ * UART itself, so use this just before
+ * knx.start() or after knx communication is
+ * stopped (i.e. during SAVE processing).
+ * *******************************************/
+// number of commands, which can be queued
+#ifndef NCN5130_QUEUE_SIZE
+#define NCN5130_QUEUE_SIZE 4
+#endif
+// default timeout for a response in ms
+#ifndef NCN5130_TIMEOUT
+#define NCN5130_TIMEOUT 100
+#endif
+// expected response of commands without any response
+#define NCN5130_NO_RESPONSE 0x00
+
+// called when the expected response is received (iSuccess) or the command timed out
+typedef void (*Ncn5130Callback)(bool iSuccess, uint8_t iResponse, uint8_t iData);
+
+class Ncn5130
+{
+  private:
+    struct sCommand
+    {
+        const char *info;
+        uint8_t data[3];
+        uint8_t length;
+        uint8_t response;
+        uint8_t responseLength;
+        uint16_t timeout;
+        Ncn5130Callback callback;
+    };
+    enum eState
+    {
+        Idle,
+        WaitResponse,
+        WaitData
+    };
+
+    static sCommand sQueue[NCN5130_QUEUE_SIZE];
+    static uint8_t sQueueHead;
+    static uint8_t sQueueCount;
+    static eState sState;
+    static uint32_t sCommandStart;
+    static bool sUartInitialized;
+
+    static void startCommand();
+    static void finishCommand(bool iSuccess, uint8_t iData);
+
+  public:
+    // Initializes the UART, if not done yet. With iForce, the UART is reinitialized.
+    static bool begin(bool iForce = false);
+    // Queues iLength (1-3) bytes starting with the command byte. With iResponse NCN5130_NO_RESPONSE the command
+    // is finished as soon as it is sent, otherwise with iResponse and iResponseLength (0/1) following data bytes.
+    // Returns false, if the queue is full.
+    static bool send(const uint8_t *iData, uint8_t iLength, uint8_t iResponse, uint8_t iResponseLength = 0,
+                     Ncn5130Callback iCallback = nullptr, const char *iInfo = nullptr, uint16_t iTimeout = NCN5130_TIMEOUT);
+    static bool send(uint8_t iCmd, uint8_t iResponse, uint8_t iResponseLength = 0, Ncn5130Callback iCallback = nullptr,
+                     const char *iInfo = nullptr, uint16_t iTimeout = NCN5130_TIMEOUT);
+    // Writes iLength bytes to the UART immediately, ahead of all queued commands and without waiting for a
+    // running command. For commands without response, which must not be delayed (i.e. power off on SAVE).
+    static void sendImmediate(const uint8_t *iData, uint8_t iLength);
+    // Sends a command and waits for its response. Returns the data byte (iResponseLength 1) or the response,
+    // 0 on timeout. Queued commands are processed before.
+    static uint8_t execute(uint8_t iCmd, uint8_t iResponse, uint8_t iResponseLength = 0, const char *iInfo = nullptr,
+                           uint16_t iTimeout = NCN5130_TIMEOUT);
+    // true, if there is no running and no queued command
+    static bool idle();
+    // processes received bytes, timeouts and the queue, call this in loop()
+    static void loop();
+};
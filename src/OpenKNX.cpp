@@ -1,4 +1,5 @@
 #include "OpenKNX.h"
+#include "Benchmark.h"
 
 VersionCheckResult OpenKNX::versionCheck(uint16_t manufacturerId, uint8_t *hardwareType, uint16_t firmwareVersion)
 {
@@ -28,6 +29,9 @@ VersionCheckResult OpenKNX::versionCheck(uint16_t manufacturerId, uint8_t *hardw
 
 void OpenKNX::knxRead(uint8_t openKnxId, uint8_t applicationNumber, uint8_t applicationVersion, uint8_t firmwareRevision, const char* OrderNo)
 {
+    // The time is spent in knx.readMemory(), which deserializes all tables. Skipping this parse (i.e. by
+    // checksums of the tables) has to be done in the knx stack, its only hook is the version check.
+    BENCHMARK_START(lBenchmarkStart);
     uint8_t hardwareType[LEN_HARDWARE_TYPE] = {0x00, 0x00, openKnxId, applicationNumber, applicationVersion, 0x00};
 
     // first setup flash version check
@@ -47,4 +51,5 @@ void OpenKNX::knxRead(uint8_t openKnxId, uint8_t applicationNumber, uint8_t appl
     {
         knx.orderNumber((const uint8_t*)OrderNo);    //set the OrderNumber
     }
+    BENCHMARK_STOP(knxRead, lBenchmarkStart, 0);
 }
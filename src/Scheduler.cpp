@@ -0,0 +1,123 @@
+#include "Scheduler.h"
+#include "HardwareDevices.h"
+
+Scheduler::Scheduler()
+{
+    for (uint8_t lIndex = 0; lIndex < SCHEDULER_MAX_TASKS; lIndex++)
+    {
+        sTask &lTask = _tasks[lIndex];
+        lTask.scheduler = this;
+        lTask.id = SCHEDULER_NO_TASK;
+        lTask.ready = false;
+        lTask.timer.callback(expired, &lTask);
+    }
+}
+
+uint32_t Scheduler::every(uint32_t iInterval, SchedulerTask iTask, void *iContext /* = nullptr */, uint8_t iPriority /* = 0 */)
+{
+    return add(iInterval, true, iTask, iContext, iPriority);
+}
+
+uint32_t Scheduler::once(uint32_t iDelay, SchedulerTask iTask, void *iContext /* = nullptr */, uint8_t iPriority /* = 0 */)
+{
+    return add(iDelay, false, iTask, iContext, iPriority);
+}
+
+uint32_t Scheduler::add(uint32_t iDelay, bool iPeriodic, SchedulerTask iTask, void *iContext, uint8_t iPriority)
+{
+    uint8_t lIndex = 0;
+    while (lIndex < SCHEDULER_MAX_TASKS && _tasks[lIndex].id != SCHEDULER_NO_TASK)
+        lIndex++;
+    if (lIndex == SCHEDULER_MAX_TASKS)
+        fatalError(FATAL_SCHEDULE_MAX_CALLBACKS, "Too many tasks in scheduler");
+    // id is a 24 bit sequence number and the slot index, the sequence number is never 0
+    _sequence = (_sequence + 1) & 0xFFFFFF;
+    if (_sequence == 0)
+        _sequence = 1;
+    sTask &lTask = _tasks[lIndex];
+    lTask.task = iTask;
+    lTask.context = iContext;
+    lTask.interval = iDelay;
+    lTask.priority = iPriority;
+    lTask.periodic = iPeriodic;
+    lTask.id = (_sequence << 8) | lIndex;
+    lTask.due = timeMicros() + (uint64_t)iDelay * 1000;
+    // a periodic task without interval needs no timer, it is always ready
+    lTask.ready = iPeriodic && iDelay == 0;
+    lTask.readyAt = lTask.due;
+    if (!lTask.ready)
+        _timers.startMillis(lTask.timer, iDelay);
+    return lTask.id;
+}
+
+bool Scheduler::cancel(uint32_t iId)
+{
+    uint8_t lIndex = iId & 0xFF;
+    if (iId == SCHEDULER_NO_TASK || lIndex >= SCHEDULER_MAX_TASKS || _tasks[lIndex].id != iId)
+        return false;
+    release(_tasks[lIndex]);
+    return true;
+}
+
+void Scheduler::release(sTask &iTask)
+{
+    iTask.timer.stop();
+    iTask.id = SCHEDULER_NO_TASK;
+    iTask.ready = false;
+}
+
+TimerWheel &Scheduler::timers()
+{
+    return _timers;
+}
+
+// called by the wheel, the task is run by loop() according to its priority
+void Scheduler::expired(void *iTask)
+{
+    sTask &lTask = *(sTask *)iTask;
+    if (!lTask.ready)
+    {
+        lTask.ready = true;
+        lTask.readyAt = lTask.due;
+    }
+    if (!lTask.periodic)
+        return;
+    // periodic tasks keep their phase, missed runs are skipped
+    uint64_t lNow = timeMicros();
+    lTask.due += (uint64_t)lTask.interval * 1000;
+    if (lTask.due <= lNow)
+        lTask.due = lNow + (uint64_t)lTask.interval * 1000;
+    lTask.scheduler->_timers.startMicros(lTask.timer, lTask.due - lNow);
+}
+
+void Scheduler::loop()
+{
+    _timers.loop();
+    uint32_t lRun = 0; // tasks already run by this call
+    for (uint8_t lCount = 0; lCount < SCHEDULER_TASKS_PER_LOOP; lCount++)
+    {
+        sTask *lNext = nullptr;
+        for (uint8_t lIndex = 0; lIndex < SCHEDULER_MAX_TASKS; lIndex++)
+        {
+            sTask &lTask = _tasks[lIndex];
+            if (!lTask.ready || (lRun & (1UL << lIndex)))
+                continue;
+            if (lNext == nullptr || lTask.priority > lNext->priority || (lTask.priority == lNext->priority && lTask.readyAt < lNext->readyAt))
+                lNext = &lTask;
+        }
+        if (lNext == nullptr)
+            return;
+        lRun |= 1UL << (lNext - _tasks);
+        SchedulerTask lCallback = lNext->task;
+        void *lContext = lNext->context;
+        if (!lNext->periodic)
+            release(*lNext);
+        else if (lNext->interval > 0)
+            lNext->ready = false;
+        else
+            // tasks running in each loop() take turns with overdue tasks of the same priority
+            lNext->readyAt = timeMicros();
+        // the task may add or cancel tasks (even itself)
+        lCallback(lContext);
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "TimerWheel.h"
+
+/*********************************************
+ * Cooperative scheduler for periodic and
+ * one-shot tasks
+ *
+ * Each task owns a timer of the TimerWheel of
+ * the scheduler, the timer just marks the task
+ * as ready when it is due. Periodic tasks are
+ * restarted at expiry, so they keep their phase.
+ * loop() runs at most SCHEDULER_TASKS_PER_LOOP
+ * ready tasks per call, higher priority first,
+ * earliest due first for equal priority, and
+ * each task at most once per call. This keeps
+ * the latency of knx.loop() bounded.
+ * Channel timers (WheelTimer) share the wheel of
+ * the scheduler, see timers().
+ * *******************************************/
+// maximum number of registered tasks
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 16
+#endif
+// maximum number of tasks run by one call of loop()
+#ifndef SCHEDULER_TASKS_PER_LOOP
+#define SCHEDULER_TASKS_PER_LOOP 2
+#endif
+// id of no task, it is never returned by every() or once()
+#define SCHEDULER_NO_TASK 0
+
+typedef void (*SchedulerTask)(void *iContext);
+
+class Scheduler
+{
+    static_assert(SCHEDULER_MAX_TASKS <= 32, "SCHEDULER_MAX_TASKS has to be 32 or less");
+
+  private:
+    struct sTask
+    {
+        WheelTimer timer;
+        Scheduler *scheduler;
+        SchedulerTask task;
+        void *context;
+        uint64_t due;     // us, next expiry of timer
+        uint64_t readyAt; // us, due time of the pending run
+        uint32_t interval;
+        uint32_t id;      // SCHEDULER_NO_TASK if unused
+        uint8_t priority;
+        bool periodic;
+        bool ready;
+    };
+
+    TimerWheel _timers;
+    sTask _tasks[SCHEDULER_MAX_TASKS];
+    uint32_t _sequence = 0;
+
+    uint32_t add(uint32_t iDelay, bool iPeriodic, SchedulerTask iTask, void *iContext, uint8_t iPriority);
+    static void expired(void *iTask);
+    void release(sTask &iTask);
+
+  public:
+    Scheduler();
+
+    // runs iTask every iInterval ms, the first time after iInterval. With iInterval 0 it runs in each loop().
+    // Returns the id of the task.
+    uint32_t every(uint32_t iInterval, SchedulerTask iTask, void *iContext = nullptr, uint8_t iPriority = 0);
+    // runs iTask once after iDelay ms. Returns the id of the task.
+    uint32_t once(uint32_t iDelay, SchedulerTask iTask, void *iContext = nullptr, uint8_t iPriority = 0);
+    // removes a task, returns false if there is no such task. Ids contain a sequence number,
+    // so the id of a finished or cancelled task never removes another task using the same slot.
+    bool cancel(uint32_t iId);
+    // wheel of this scheduler for timers of channels (i.e. delays and staircase timers)
+    TimerWheel &timers();
+    // runs expired timers and ready tasks, call this in loop()
+    void loop();
+};
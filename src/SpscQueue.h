@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Lock-free queue for exactly one producer and one consumer, i.e. to pass messages between the
+ * two cores of the RP2040. The producer just changes _tail, the consumer just changes _head, so
+ * there are no locks and push()/pop() never block. Capacity has to be a power of two.
+ */
+template <typename T, uint16_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+  public:
+    // producer: false, if the queue is full
+    bool push(const T& iItem)
+    {
+        uint16_t lTail = _tail.load(std::memory_order_relaxed);
+        if ((uint16_t)(lTail - _head.load(std::memory_order_acquire)) == Capacity)
+            return false;
+        _items[lTail & (Capacity - 1)] = iItem;
+        _tail.store(lTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer: false, if the queue is empty
+    bool pop(T& oItem)
+    {
+        uint16_t lHead = _head.load(std::memory_order_relaxed);
+        if (lHead == _tail.load(std::memory_order_acquire))
+            return false;
+        oItem = _items[lHead & (Capacity - 1)];
+        _head.store(lHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // producer: number of items, which can be pushed at least
+    uint16_t free() const
+    {
+        return Capacity - (uint16_t)(_tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_acquire));
+    }
+
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    T _items[Capacity];
+    std::atomic<uint16_t> _head{0};
+    std::atomic<uint16_t> _tail{0};
+};
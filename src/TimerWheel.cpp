@@ -0,0 +1,175 @@
+#include "TimerWheel.h"
+#include "Helper.h"
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <hardware/timer.h>
+#endif
+
+constexpr uint64_t Deadline::Never;
+
+uint64_t timeMicros()
+{
+#ifdef ARDUINO_ARCH_RP2040
+    return time_us_64();
+#else
+    // micros() is extended by counting its overflows
+    static uint32_t sLastMicros = 0;
+    static uint32_t sOverflows = 0;
+    uint32_t lState = enterCritical();
+    uint32_t lNow = micros();
+    if (lNow < sLastMicros)
+        sOverflows++;
+    sLastMicros = lNow;
+    uint64_t lResult = ((uint64_t)sOverflows << 32) | lNow;
+    exitCritical(lState);
+    return lResult;
+#endif
+}
+
+Deadline Deadline::inMicros(uint64_t iMicros)
+{
+    Deadline lDeadline;
+    lDeadline.startMicros(iMicros);
+    return lDeadline;
+}
+
+Deadline Deadline::inMillis(uint32_t iMillis)
+{
+    return inMicros((uint64_t)iMillis * 1000);
+}
+
+void Deadline::startMicros(uint64_t iMicros)
+{
+    _at = timeMicros() + iMicros;
+}
+
+void Deadline::startMillis(uint32_t iMillis)
+{
+    startMicros((uint64_t)iMillis * 1000);
+}
+
+void Deadline::stop()
+{
+    _at = Never;
+}
+
+bool Deadline::active() const
+{
+    return _at != Never;
+}
+
+// 64 bit time does not overflow, so a plain comparison is safe
+bool Deadline::expired() const
+{
+    return _at != Never && timeMicros() >= _at;
+}
+
+uint64_t Deadline::remainingMicros() const
+{
+    if (_at == Never)
+        return Never;
+    uint64_t lNow = timeMicros();
+    return (lNow >= _at) ? 0 : _at - lNow;
+}
+
+WheelTimer::WheelTimer(TimerCallback iCallback, void *iContext /* = nullptr */)
+{
+    _callback = iCallback;
+    _context = iContext;
+}
+
+WheelTimer::~WheelTimer()
+{
+    stop();
+}
+
+void WheelTimer::callback(TimerCallback iCallback, void *iContext /* = nullptr */)
+{
+    _callback = iCallback;
+    _context = iContext;
+}
+
+bool WheelTimer::running() const
+{
+    return _list != nullptr;
+}
+
+void WheelTimer::stop()
+{
+    if (_list)
+        TimerWheel::unlink(*this);
+}
+
+TimerWheel::TimerWheel()
+{
+    memset(_slots, 0, sizeof(_slots));
+    _tick = timeMicros() / TIMER_WHEEL_TICK;
+}
+
+void TimerWheel::link(WheelTimer &iTimer, WheelTimer **iList)
+{
+    iTimer._list = iList;
+    iTimer._prev = nullptr;
+    iTimer._next = *iList;
+    if (*iList)
+        (*iList)->_prev = &iTimer;
+    *iList = &iTimer;
+}
+
+void TimerWheel::unlink(WheelTimer &iTimer)
+{
+    if (iTimer._prev)
+        iTimer._prev->_next = iTimer._next;
+    else
+        *iTimer._list = iTimer._next;
+    if (iTimer._next)
+        iTimer._next->_prev = iTimer._prev;
+    iTimer._list = nullptr;
+    iTimer._next = nullptr;
+    iTimer._prev = nullptr;
+}
+
+void TimerWheel::startMicros(WheelTimer &iTimer, uint64_t iMicros)
+{
+    iTimer.stop();
+    // rounded up, so the timer never expires early
+    iTimer._tick = (timeMicros() + iMicros + TIMER_WHEEL_TICK - 1) / TIMER_WHEEL_TICK;
+    // a timer expiring now is checked with the next tick, so a callback restarting its timer does not loop
+    uint64_t lSlot = (iTimer._tick > _tick) ? iTimer._tick : _tick + 1;
+    link(iTimer, &_slots[lSlot & (TIMER_WHEEL_SLOTS - 1)]);
+}
+
+void TimerWheel::startMillis(WheelTimer &iTimer, uint32_t iMillis)
+{
+    startMicros(iTimer, (uint64_t)iMillis * 1000);
+}
+
+void TimerWheel::loop()
+{
+    uint64_t lNow = timeMicros() / TIMER_WHEEL_TICK;
+    // after a long pause each slot is checked once with the current tick
+    if (lNow - _tick > TIMER_WHEEL_SLOTS)
+        _tick = lNow - TIMER_WHEEL_SLOTS;
+    while (_tick < lNow)
+    {
+        _tick++;
+        WheelTimer *lTimer = _slots[_tick & (TIMER_WHEEL_SLOTS - 1)];
+        while (lTimer)
+        {
+            WheelTimer *lNext = lTimer->_next;
+            if (lTimer->_tick <= _tick)
+            {
+                unlink(*lTimer);
+                link(*lTimer, &_expired);
+            }
+            lTimer = lNext;
+        }
+    }
+    // callbacks may start or stop any timer (even the running one), so each one is taken from the list before
+    while (_expired)
+    {
+        WheelTimer *lTimer = _expired;
+        unlink(*lTimer);
+        lTimer->_callback(lTimer->_context);
+    }
+}
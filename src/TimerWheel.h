@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+
+/*********************************************
+ * Timer service with microsecond resolution
+ *
+ * timeMicros() is a 64 bit microsecond time,
+ * which does not overflow and can be used in
+ * interrupt handlers.
+ * Deadline is a point in time to poll with
+ * expired(), it replaces delayCheck() and
+ * delayTimerInit() (no 0 sentinel, stop() makes
+ * it inactive).
+ * TimerWheel runs callbacks of any number of
+ * WheelTimer objects. Timers are sorted into slots
+ * by their expiry tick, so loop() just checks
+ * the slots of the ticks passed since the last
+ * call instead of comparing each timer.
+ * Timers and the wheel must not be used in
+ * interrupt handlers.
+ * Each Scheduler owns a wheel and runs it in its
+ * loop(), channels use the one of
+ * openknx.scheduler() (openknx.timers()).
+ * *******************************************/
+// resolution of TimerWheel in us
+#ifndef TIMER_WHEEL_TICK
+#define TIMER_WHEEL_TICK 1000
+#endif
+// number of slots of TimerWheel (power of two), timers further away than slots * tick stay for more rounds
+#ifndef TIMER_WHEEL_SLOTS
+#define TIMER_WHEEL_SLOTS 64
+#endif
+
+// microseconds since start, interrupt safe. Without a 64 bit hardware timer it has to be
+// called at least once per overflow of micros() (71 minutes), TimerWheel::loop() does this.
+uint64_t timeMicros();
+
+class Deadline
+{
+  public:
+    static constexpr uint64_t Never = UINT64_MAX;
+
+    // inactive deadline, it never expires
+    Deadline() {}
+    static Deadline inMicros(uint64_t iMicros);
+    static Deadline inMillis(uint32_t iMillis);
+
+    void startMicros(uint64_t iMicros);
+    void startMillis(uint32_t iMillis);
+    void stop();
+    bool active() const;
+    bool expired() const;
+    // 0 if expired, Never if inactive
+    uint64_t remainingMicros() const;
+
+  private:
+    uint64_t _at = Never;
+};
+
+class TimerWheel;
+
+typedef void (*TimerCallback)(void *iContext);
+
+// a timer of TimerWheel, usually a member of the channel using it
+class WheelTimer
+{
+    friend class TimerWheel;
+
+  public:
+    // timer without callback, set it with callback() before it is started
+    WheelTimer() {}
+    WheelTimer(TimerCallback iCallback, void *iContext = nullptr);
+    ~WheelTimer();
+    WheelTimer(const WheelTimer &) = delete;
+    WheelTimer &operator=(const WheelTimer &) = delete;
+
+    void callback(TimerCallback iCallback, void *iContext = nullptr);
+    bool running() const;
+    void stop();
+
+  private:
+    TimerCallback _callback = nullptr;
+    void *_context = nullptr;
+    uint64_t _tick = 0;
+    WheelTimer *_next = nullptr;
+    WheelTimer *_prev = nullptr;
+    WheelTimer **_list = nullptr; // head of the list containing the timer, nullptr if not running
+};
+
+class TimerWheel
+{
+    friend class WheelTimer;
+    static_assert((TIMER_WHEEL_SLOTS & (TIMER_WHEEL_SLOTS - 1)) == 0, "TIMER_WHEEL_SLOTS has to be a power of two");
+
+  public:
+    TimerWheel();
+
+    // (re)starts iTimer, its callback is called from loop() not before iMicros
+    void startMicros(WheelTimer &iTimer, uint64_t iMicros);
+    void startMillis(WheelTimer &iTimer, uint32_t iMillis);
+    // calls the callbacks of all expired timers, call this in loop()
+    void loop();
+
+  private:
+    WheelTimer *_slots[TIMER_WHEEL_SLOTS];
+    WheelTimer *_expired = nullptr;
+    uint64_t _tick; // last processed tick
+
+    static void link(WheelTimer &iTimer, WheelTimer **iList);
+    static void unlink(WheelTimer &iTimer);
+};
@@ -1,4 +1,9 @@
 #include "oknx.h"
+#include "Helper.h"
+#include "EepromManager.h"
+#include "Ncn5130.h"
+#include "LoopStats.h"
+#include "I2cRegistry.h"
 
 OpenKNXfacade openknx;
 
@@ -7,10 +12,92 @@ FlashUserData* OpenKNXfacade::flashUserData()
     return _flashUserDataPtr; 
 }
 
+Scheduler& OpenKNXfacade::scheduler()
+{
+    return _scheduler;
+}
+
+Scheduler& OpenKNXfacade::ioScheduler()
+{
+    return _ioScheduler;
+}
+
+TimerWheel& OpenKNXfacade::timers()
+{
+    return _scheduler.timers();
+}
+
 void OpenKNXfacade::loop() {
+#ifdef OPENKNX_DUALCORE
+    // setup is finished, core 0 owns I2C from now on and core 1 starts working
+    if (!_core1Started.load(std::memory_order_relaxed))
+    {
+        I2cLock::acquire();
+        _core1Started.store(true, std::memory_order_release);
+    }
+#endif
+    LOOPSTATS_BEGIN();
     _flashUserDataPtr->loop();
+    LOOPSTATS_STAGE(StageFlash);
+    // core 1 gets the I2C buses while core 0 is busy with knx
+    I2cLock::release();
     knx.loop();
+    I2cLock::acquire();
+    LOOPSTATS_STAGE(StageKnx);
+    EepromManager::loop();
+    LOOPSTATS_STAGE(StageEeprom);
+    Ncn5130::loop();
+    LOOPSTATS_STAGE(StageNcn5130);
+    _scheduler.loop();
+    LOOPSTATS_STAGE(StageScheduler);
+#ifndef OPENKNX_DUALCORE
+    _ioScheduler.loop();
+    LOOPSTATS_STAGE(StageIoScheduler);
+#endif
+    printDebugLoop();
+    LOOPSTATS_STAGE(StageDebug);
+}
+
+void OpenKNXfacade::printLoopStats(bool iReset /* = false */)
+{
+#ifdef OPENKNX_LOOPSTATS
+    LoopStats::print();
+    if (iReset)
+        LoopStats::reset();
+#else
+    (void)iReset;
+    printDebug("loop statistics need OPENKNX_LOOPSTATS to be defined\n");
+#endif
+}
+
+#ifdef OPENKNX_LOOPSTATS
+// sends the longest loop iteration of the last interval in us (DPT 13)
+static void sendLoopStats(void *iContext)
+{
+    GroupObject *lKo = (GroupObject *)iContext;
+    lKo->value((int32_t)LoopStats::takeMaxTotal(), Dpt(13, 1));
+}
+#endif
+
+void OpenKNXfacade::loopStatsObject(GroupObject &iKo, uint32_t iInterval)
+{
+#ifdef OPENKNX_LOOPSTATS
+    LoopStats::takeMaxTotal();
+    _scheduler.every(iInterval, sendLoopStats, &iKo);
+#else
+    (void)iKo;
+    (void)iInterval;
+#endif
+}
+
+#ifdef OPENKNX_DUALCORE
+void OpenKNXfacade::loop1() {
+    if (!_core1Started.load(std::memory_order_acquire))
+        return;
+    EepromManager::process();
+    _ioScheduler.loop();
 }
+#endif
 
 void OpenKNXfacade::readMemory(uint8_t openKnxId, uint8_t applicationNumber, uint8_t applicationVersion, uint8_t firmwareRevision, const char* OrderNo /*= nullptr*/)
 {
@@ -3,18 +3,50 @@
 #include "knx.h"
 #include "OpenKNX.h"
 #include "FlashUserData.h"
+#include "Scheduler.h"
+#include <atomic>
+
+// OPENKNX_DUALCORE: knx.loop() keeps core 0 for itself, EEPROM writes and tasks of ioScheduler() run on core 1.
+// The firmware defines loop1() and calls openknx.loop1() there. Core 1 may use I2C while knx.loop() runs, so
+// callbacks of group objects (they run within knx.loop()) have to take an I2cLock for each I2C access.
+// EepromManager::writeAsync() has to be called on core 0, not in tasks of ioScheduler().
+#if defined(OPENKNX_DUALCORE) && !defined(ARDUINO_ARCH_RP2040)
+#error "OPENKNX_DUALCORE is just supported on RP2040"
+#endif
 
 class OpenKNXfacade
 {
 private:
     FlashUserData* _flashUserDataPtr;
-    
+    Scheduler _scheduler;
+    Scheduler _ioScheduler;
+#ifdef OPENKNX_DUALCORE
+    std::atomic<bool> _core1Started{false};
+#endif
+
 public:
     OpenKNXfacade() : _flashUserDataPtr(new FlashUserData()) {};
     ~OpenKNXfacade() {};
 
     FlashUserData* flashUserData(); 
+    // modules register their periodic and one-shot tasks here instead of polling with delayCheck()
+    Scheduler& scheduler();
+    // Tasks polling sensors or other slow I/O go here. With OPENKNX_DUALCORE they run on core 1, so they
+    // must use I2cLock for I2C (they get it while core 0 runs knx.loop()) and should be registered in setup()
+    // (the scheduler is not shared between cores).
+    Scheduler& ioScheduler();
+    // timers of channels (i.e. delays and staircase timers), the wheel of scheduler(), their callbacks run in loop()
+    TimerWheel& timers();
     void loop();
+    // debug only: prints the duration of each stage of loop(), needs OPENKNX_LOOPSTATS
+    void printLoopStats(bool iReset = false);
+    // sends the longest loop iteration (us, DPT 13) every iInterval ms on iKo, needs OPENKNX_LOOPSTATS
+    void loopStatsObject(GroupObject& iKo, uint32_t iInterval);
+#ifdef OPENKNX_DUALCORE
+    // call this in loop1() of the firmware (arduino-pico runs it on core 1),
+    // it starts working after the first loop() on core 0 (setup is finished)
+    void loop1();
+#endif
     void readMemory(uint8_t openKnxId, uint8_t applicationNumber, uint8_t applicationVersion, uint8_t firmwareRevision, const char* OrderNo = nullptr);
 };
 
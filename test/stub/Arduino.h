@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************************
+ * Arduino core for native unit tests
+ *
+ * Just what the sources need. Time does not
+ * run by itself, tests move it forward with
+ * stubAdvanceMicros() and stubAdvanceMillis().
+ * The emulated devices (EEPROM in Wire.h,
+ * NCN5130 in HardwareSerial.h, flash in knx.h)
+ * move it forward by the time their operations
+ * take. Serial writes to stdout. Pins have no
+ * function, inputs read HIGH.
+ * *******************************************/
+
+inline uint64_t &stubMicros()
+{
+    static uint64_t sMicros = 0;
+    return sMicros;
+}
+
+inline void stubAdvanceMicros(uint64_t iMicros)
+{
+    stubMicros() += iMicros;
+}
+
+inline void stubAdvanceMillis(uint32_t iMillis)
+{
+    stubAdvanceMicros((uint64_t)iMillis * 1000);
+}
+
+inline unsigned long micros()
+{
+    return (uint32_t)stubMicros();
+}
+
+inline unsigned long millis()
+{
+    return (uint32_t)(stubMicros() / 1000);
+}
+
+inline void delay(unsigned long iMillis)
+{
+    stubAdvanceMillis(iMillis);
+}
+
+inline void delayMicroseconds(unsigned int iMicros)
+{
+    stubAdvanceMicros(iMicros);
+}
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+typedef bool boolean;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+static const uint8_t SDA = 4;
+static const uint8_t SCL = 5;
+
+inline void pinMode(uint8_t /* iPin */, uint8_t /* iMode */) {}
+inline void digitalWrite(uint8_t /* iPin */, uint8_t /* iValue */) {}
+inline int digitalRead(uint8_t /* iPin */)
+{
+    return HIGH;
+}
+
+class StubSerial
+{
+  public:
+    size_t print(const char *iText)
+    {
+        return write((const uint8_t *)iText, strlen(iText));
+    }
+    size_t write(const uint8_t *iData, size_t iLength)
+    {
+        return fwrite(iData, 1, iLength, stdout);
+    }
+    size_t write(uint8_t iData)
+    {
+        return write(&iData, 1);
+    }
+    int availableForWrite()
+    {
+        return 256;
+    }
+    void flush()
+    {
+        fflush(stdout);
+    }
+};
+
+inline StubSerial Serial;
+
+#include "HardwareSerial.h"
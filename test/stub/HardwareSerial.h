@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+
+/*********************************************
+ * Serial1 for native unit tests: NCN5130
+ *
+ * Answers the commands used by Ncn5130 and
+ * HardwareDevices like a NCN5130 in normal
+ * operation. A response is received after the
+ * command and the response are transmitted at
+ * 19200 baud. Each poll of available() without
+ * data takes some time, so a wait for a
+ * response with timeout always ends.
+ * *******************************************/
+#define SERIAL_8E1 0x2E
+
+// duration of one byte at 19200 baud with 8E1 (11 bits) in us
+#ifndef STUB_UART_BYTE_TIME
+#define STUB_UART_BYTE_TIME 573
+#endif
+// duration of a call of available() without received data in us
+#ifndef STUB_UART_POLL_TIME
+#define STUB_UART_POLL_TIME 10
+#endif
+#define STUB_UART_BUFFER_SIZE 32
+
+class StubNcn5130
+{
+  public:
+    void begin(unsigned long /* iBaud */, uint16_t /* iConfig */)
+    {
+        _open = true;
+    }
+    void end()
+    {
+        _open = false;
+    }
+    explicit operator bool() const
+    {
+        return _open;
+    }
+    size_t write(const uint8_t *iData, size_t iLength)
+    {
+        for (size_t lIndex = 0; lIndex < iLength; lIndex++)
+            receive(iData[lIndex]);
+        return iLength;
+    }
+    size_t write(uint8_t iData)
+    {
+        return write(&iData, 1);
+    }
+    int available()
+    {
+        uint8_t lCount = 0;
+        while (lCount < _count && _buffer[(_head + lCount) % STUB_UART_BUFFER_SIZE].at <= stubMicros())
+            lCount++;
+        if (lCount == 0)
+            stubAdvanceMicros(STUB_UART_POLL_TIME);
+        return lCount;
+    }
+    int read()
+    {
+        if (_count == 0 || _buffer[_head].at > stubMicros())
+            return -1;
+        uint8_t lByte = _buffer[_head].data;
+        _head = (_head + 1) % STUB_UART_BUFFER_SIZE;
+        _count--;
+        return lByte;
+    }
+
+    // test helpers: without connection nothing is answered
+    void stubConnected(bool iConnected)
+    {
+        _connected = iConnected;
+    }
+    // internal register (0 = WD, 1 = ACR0, 2 = ACR1, 3 = ASR0)
+    uint8_t stubRegister(uint8_t iIndex)
+    {
+        return _registers[iIndex & 3];
+    }
+
+  private:
+    struct sByte
+    {
+        uint64_t at; // us, time the byte is received
+        uint8_t data;
+    };
+
+    sByte _buffer[STUB_UART_BUFFER_SIZE];
+    uint8_t _head = 0;
+    uint8_t _count = 0;
+    uint8_t _registers[4] = {0, 0x74, 0, 0}; // ACR0: 5V and 20V rail on
+    uint8_t _command = 0; // write register command waiting for its data byte
+    bool _open = false;
+    bool _connected = true;
+
+    void receive(uint8_t iByte)
+    {
+        if (_command)
+        {
+            // U_INT_REG_WR_REQ_*, no response
+            _registers[_command & 3] = iByte;
+            _command = 0;
+            return;
+        }
+        if (!_connected)
+            return;
+        if ((iByte & 0xFC) == 0x28)
+            _command = iByte;
+        else if ((iByte & 0xFC) == 0x38)
+            respond(_registers[iByte & 3]); // U_INT_REG_RD_REQ_*
+        else if (iByte == 0x0D)
+        {
+            // U_SYSTEM_STATE: U_SYSTEM_STAT_IND, normal operation
+            respond(0x4B);
+            respond(0x03);
+        }
+        else if (iByte == 0x0E)
+            respond(0x2B); // U_STOP_MODE_REQ: U_STOP_MODE_IND
+        else if (iByte == 0x01 || iByte == 0x0F)
+            respond(0x03); // U_RESET_REQ, U_EXIT_STOP_MODE_REQ: U_RESET_IND
+        else if (iByte == 0x02)
+            respond(0x07); // U_STATE_REQ: U_STATE_IND
+    }
+
+    void respond(uint8_t iByte)
+    {
+        if (_count == STUB_UART_BUFFER_SIZE)
+            return;
+        // the command byte and each response byte before take their time on the line
+        uint64_t lAt = stubMicros() + STUB_UART_BYTE_TIME;
+        if (_count > 0 && _buffer[(_head + _count - 1) % STUB_UART_BUFFER_SIZE].at >= lAt)
+            lAt = _buffer[(_head + _count - 1) % STUB_UART_BUFFER_SIZE].at;
+        _buffer[(_head + _count) % STUB_UART_BUFFER_SIZE] = {lAt + STUB_UART_BYTE_TIME, iByte};
+        _count++;
+    }
+};
+
+inline StubNcn5130 Serial1;
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <Arduino.h>
+
+/*********************************************
+ * Wire for native unit tests: 24LC256
+ *
+ * The bus has a 24LC256 EEPROM at 0x50, all
+ * other addresses do not answer. Like the
+ * device, a write wraps at its page boundary
+ * and starts an internal write cycle, during
+ * which the device does not acknowledge its
+ * address (ACK polling). Each byte on the bus
+ * takes its time at 400 kHz.
+ * *******************************************/
+#define STUB_EEPROM_ADDRESS 0x50
+#define STUB_EEPROM_SIZE 32768
+#define STUB_EEPROM_PAGE_SIZE 64
+// duration of one byte (with ACK) at 400 kHz in us
+#ifndef STUB_I2C_BYTE_TIME
+#define STUB_I2C_BYTE_TIME 23
+#endif
+// duration of the internal write cycle of the EEPROM in us (at most 5 ms)
+#ifndef STUB_EEPROM_WRITE_TIME
+#define STUB_EEPROM_WRITE_TIME 3500
+#endif
+#define STUB_WIRE_BUFFER_SIZE 256
+
+class TwoWire
+{
+  public:
+    TwoWire()
+    {
+        stubErase();
+    }
+
+    void begin() {}
+    void end() {}
+    void setClock(uint32_t /* iFrequency */) {}
+    void setTimeout(unsigned long iTimeout)
+    {
+        _timeout = iTimeout;
+    }
+    unsigned long getTimeout()
+    {
+        return _timeout;
+    }
+
+    void beginTransmission(int iAddress)
+    {
+        _address = iAddress;
+        _txLength = 0;
+    }
+    size_t write(uint8_t iData)
+    {
+        if (_txLength == STUB_WIRE_BUFFER_SIZE)
+            return 0;
+        _tx[_txLength++] = iData;
+        return 1;
+    }
+    size_t write(const uint8_t *iData, size_t iLength)
+    {
+        size_t lWritten = 0;
+        while (lWritten < iLength && write(iData[lWritten]))
+            lWritten++;
+        return lWritten;
+    }
+    // 0: success, 2: address not acknowledged
+    uint8_t endTransmission(bool /* iStop */ = true)
+    {
+        stubAdvanceMicros((uint64_t)(_txLength + 1) * STUB_I2C_BYTE_TIME);
+        if (!acknowledged())
+            return 2;
+        if (_txLength >= 2)
+            _pointer = ((_tx[0] << 8) | _tx[1]) % STUB_EEPROM_SIZE;
+        if (_txLength > 2)
+        {
+            // the address counter wraps within the page
+            uint16_t lPage = _pointer - _pointer % STUB_EEPROM_PAGE_SIZE;
+            for (uint16_t lIndex = 2; lIndex < _txLength; lIndex++)
+            {
+                _memory[_pointer] = _tx[lIndex];
+                _pointer = lPage + (_pointer + 1) % STUB_EEPROM_PAGE_SIZE;
+            }
+            _busyUntil = stubMicros() + STUB_EEPROM_WRITE_TIME;
+            _writes++;
+        }
+        return 0;
+    }
+    uint8_t requestFrom(int iAddress, size_t iLength, bool /* iStop */ = true)
+    {
+        _address = iAddress;
+        _rxLength = 0;
+        _rxPos = 0;
+        stubAdvanceMicros((uint64_t)(iLength + 1) * STUB_I2C_BYTE_TIME);
+        if (!acknowledged() || iLength > STUB_WIRE_BUFFER_SIZE)
+            return 0;
+        // sequential read wraps at the end of the memory
+        for (size_t lIndex = 0; lIndex < iLength; lIndex++)
+        {
+            _rx[_rxLength++] = _memory[_pointer];
+            _pointer = (_pointer + 1) % STUB_EEPROM_SIZE;
+        }
+        _reads++;
+        return _rxLength;
+    }
+    int available()
+    {
+        return _rxLength - _rxPos;
+    }
+    int read()
+    {
+        return _rxPos < _rxLength ? _rx[_rxPos++] : -1;
+    }
+
+    // test helpers
+    void stubErase()
+    {
+        memset(_memory, 0xFF, sizeof(_memory));
+        _busyUntil = 0;
+        _writes = 0;
+        _reads = 0;
+    }
+    uint8_t *stubMemory()
+    {
+        return _memory;
+    }
+    // number of write transactions (each starts a write cycle) and read transactions
+    uint32_t stubWrites()
+    {
+        return _writes;
+    }
+    uint32_t stubReads()
+    {
+        return _reads;
+    }
+    // without EEPROM no address is acknowledged
+    void stubPresent(bool iPresent)
+    {
+        _present = iPresent;
+    }
+
+  private:
+    uint8_t _memory[STUB_EEPROM_SIZE];
+    uint8_t _tx[STUB_WIRE_BUFFER_SIZE];
+    uint8_t _rx[STUB_WIRE_BUFFER_SIZE];
+    uint16_t _txLength = 0;
+    uint16_t _rxLength = 0;
+    uint16_t _rxPos = 0;
+    uint16_t _pointer = 0;
+    uint64_t _busyUntil = 0;
+    uint32_t _writes = 0;
+    uint32_t _reads = 0;
+    unsigned long _timeout = 25;
+    int _address = 0;
+    bool _present = true;
+
+    bool acknowledged()
+    {
+        return _present && _address == STUB_EEPROM_ADDRESS && stubMicros() >= _busyUntil;
+    }
+};
+
+inline TwoWire Wire;
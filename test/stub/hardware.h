@@ -0,0 +1,5 @@
+#pragma once
+
+// board definitions of the firmware: the native board has just the EEPROM (see Wire.h) and
+// the NCN5130 (see HardwareSerial.h)
+#define I2C_EEPROM_DEVICE_ADDRESSS 0x50
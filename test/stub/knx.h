@@ -0,0 +1,327 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <filesystem>
+#include <Arduino.h>
+#include "knx/bits.h"
+
+/*********************************************
+ * knx stack for native unit tests
+ *
+ * Just what OpenKNX uses: the facade knx with
+ * its platform (non-volatile memory), the
+ * device object and the callbacks.
+ *
+ * The platform emulates memory-mapped flash
+ * like the RP2040 platform of the knx stack:
+ * writes go to a buffered erase block, which
+ * is erased and programmed when another block
+ * is written or on commit. Reads use the
+ * mapped flash, so uncommitted data is not
+ * visible. Flash is kept in a file, so it
+ * survives stubReboot() (and the test run).
+ *
+ * readMemory() takes the device object from a
+ * small image at the start of flash, which
+ * stubProgram() writes like ETS would do.
+ * *******************************************/
+#define LEN_HARDWARE_TYPE 6
+
+#ifndef STUB_FLASH_SIZE
+#define STUB_FLASH_SIZE 0x10000
+#endif
+#ifndef STUB_FLASH_BLOCK_SIZE
+#define STUB_FLASH_BLOCK_SIZE 256
+#endif
+// duration of erasing and of programming one block in us
+#ifndef STUB_FLASH_ERASE_TIME
+#define STUB_FLASH_ERASE_TIME 4000
+#endif
+#ifndef STUB_FLASH_PROGRAM_TIME
+#define STUB_FLASH_PROGRAM_TIME 1000
+#endif
+// file keeping the flash, in the temp directory
+#ifndef STUB_FLASH_FILE
+#define STUB_FLASH_FILE "openknx_stub_flash.bin"
+#endif
+// marks the device object image written by stubProgram()
+#define STUB_KNX_PROGRAMMED 0xA5
+
+enum VersionCheckResult
+{
+    FlashAllInvalid = 0,
+    FlashTablesInvalid = 1,
+    FlashValid = 2
+};
+
+typedef VersionCheckResult (*VersionCheckCallback)(uint16_t manufacturerId, uint8_t *hardwareType, uint16_t version);
+typedef void (*BeforeRestartCallback)(void);
+typedef void (*BeforeTablesUnloadCallback)(void);
+
+class StubPlatform
+{
+  public:
+    StubPlatform()
+    {
+        load();
+    }
+
+    uint8_t *getNonVolatileMemoryStart()
+    {
+        return _flash;
+    }
+    size_t getNonVolatileMemorySize()
+    {
+        return STUB_FLASH_SIZE;
+    }
+    uint32_t writeNonVolatileMemory(uint32_t iRelativeAddress, uint8_t *iBuffer, size_t iSize)
+    {
+        while (iSize > 0 && iRelativeAddress < STUB_FLASH_SIZE)
+        {
+            loadBlock(iRelativeAddress / STUB_FLASH_BLOCK_SIZE);
+            uint32_t lOffset = iRelativeAddress % STUB_FLASH_BLOCK_SIZE;
+            size_t lLength = STUB_FLASH_BLOCK_SIZE - lOffset;
+            if (lLength > iSize)
+                lLength = iSize;
+            memcpy(_block + lOffset, iBuffer, lLength);
+            _blockDirty = true;
+            iRelativeAddress += lLength;
+            iBuffer += lLength;
+            iSize -= lLength;
+        }
+        return iRelativeAddress;
+    }
+    void commitNonVolatileMemory()
+    {
+        writeBlock();
+    }
+    void restart()
+    {
+        _restarts++;
+    }
+
+    // test helpers
+    // erases the whole flash (and its file)
+    void stubErase()
+    {
+        memset(_flash, 0xFF, sizeof(_flash));
+        _blockNumber = -1;
+        _blockDirty = false;
+        _erases = 0;
+        _restarts = 0;
+        store();
+    }
+    // power loss: uncommitted data is lost, flash is read from file again
+    void stubReboot()
+    {
+        load();
+    }
+    // number of erased (and programmed) blocks
+    uint32_t stubErases()
+    {
+        return _erases;
+    }
+    uint32_t stubRestarts()
+    {
+        return _restarts;
+    }
+
+  private:
+    uint8_t _flash[STUB_FLASH_SIZE];
+    uint8_t _block[STUB_FLASH_BLOCK_SIZE];
+    int32_t _blockNumber = -1;
+    bool _blockDirty = false;
+    uint32_t _erases = 0;
+    uint32_t _restarts = 0;
+
+    static std::string path()
+    {
+        return (std::filesystem::temp_directory_path() / STUB_FLASH_FILE).string();
+    }
+    void load()
+    {
+        memset(_flash, 0xFF, sizeof(_flash));
+        _blockNumber = -1;
+        _blockDirty = false;
+        FILE *lFile = fopen(path().c_str(), "rb");
+        if (lFile == nullptr)
+            return;
+        if (fread(_flash, 1, sizeof(_flash), lFile) != sizeof(_flash))
+            memset(_flash, 0xFF, sizeof(_flash));
+        fclose(lFile);
+    }
+    void store()
+    {
+        FILE *lFile = fopen(path().c_str(), "wb");
+        if (lFile == nullptr)
+            return;
+        fwrite(_flash, 1, sizeof(_flash), lFile);
+        fclose(lFile);
+    }
+    void loadBlock(int32_t iBlock)
+    {
+        if (iBlock == _blockNumber)
+            return;
+        writeBlock();
+        memcpy(_block, _flash + iBlock * STUB_FLASH_BLOCK_SIZE, STUB_FLASH_BLOCK_SIZE);
+        _blockNumber = iBlock;
+    }
+    void writeBlock()
+    {
+        if (!_blockDirty)
+            return;
+        memcpy(_flash + _blockNumber * STUB_FLASH_BLOCK_SIZE, _block, STUB_FLASH_BLOCK_SIZE);
+        _blockDirty = false;
+        _erases++;
+        stubAdvanceMicros(STUB_FLASH_ERASE_TIME + STUB_FLASH_PROGRAM_TIME);
+        store();
+    }
+};
+
+class DeviceObject
+{
+  public:
+    uint8_t *hardwareType()
+    {
+        return _hardwareType;
+    }
+    void hardwareType(const uint8_t *iValue)
+    {
+        memcpy(_hardwareType, iValue, LEN_HARDWARE_TYPE);
+    }
+    uint16_t version()
+    {
+        return _version;
+    }
+    void version(uint16_t iValue)
+    {
+        _version = iValue;
+    }
+
+  private:
+    uint8_t _hardwareType[LEN_HARDWARE_TYPE] = {};
+    uint16_t _version = 0;
+};
+
+class BauStub
+{
+  public:
+    DeviceObject &deviceObject()
+    {
+        return _deviceObject;
+    }
+    void versionCheckCallback(VersionCheckCallback iCallback)
+    {
+        _versionCheck = iCallback;
+    }
+    VersionCheckCallback versionCheckCallback()
+    {
+        return _versionCheck;
+    }
+
+  private:
+    DeviceObject _deviceObject;
+    VersionCheckCallback _versionCheck = nullptr;
+};
+
+class TableObject
+{
+  public:
+    static void beforeTablesUnloadCallback(BeforeTablesUnloadCallback iCallback)
+    {
+        callback() = iCallback;
+    }
+    static BeforeTablesUnloadCallback beforeTablesUnloadCallback()
+    {
+        return callback();
+    }
+
+  private:
+    static BeforeTablesUnloadCallback &callback()
+    {
+        static BeforeTablesUnloadCallback sCallback = nullptr;
+        return sCallback;
+    }
+};
+
+class KnxFacade
+{
+  public:
+    StubPlatform &platform()
+    {
+        return _platform;
+    }
+    BauStub &bau()
+    {
+        return _bau;
+    }
+    bool configured()
+    {
+        return _configured;
+    }
+    void configured(bool iValue)
+    {
+        _configured = iValue;
+    }
+    void beforeRestartCallback(BeforeRestartCallback iCallback)
+    {
+        _beforeRestart = iCallback;
+    }
+    BeforeRestartCallback beforeRestartCallback()
+    {
+        return _beforeRestart;
+    }
+    void orderNumber(const uint8_t *iValue)
+    {
+        strncpy(_orderNumber, (const char *)iValue, sizeof(_orderNumber) - 1);
+    }
+    const char *orderNumber()
+    {
+        return _orderNumber;
+    }
+    // the device is configured, if the version check accepts the programmed device object
+    void readMemory()
+    {
+        _configured = false;
+        const uint8_t *lImage = _platform.getNonVolatileMemoryStart();
+        if (lImage[0] != STUB_KNX_PROGRAMMED)
+            return;
+        uint16_t lManufacturerId;
+        uint16_t lVersion;
+        uint8_t lHardwareType[LEN_HARDWARE_TYPE];
+        popWord(lManufacturerId, lImage + 1);
+        memcpy(lHardwareType, lImage + 3, LEN_HARDWARE_TYPE);
+        popWord(lVersion, lImage + 3 + LEN_HARDWARE_TYPE);
+        VersionCheckCallback lCheck = _bau.versionCheckCallback();
+        VersionCheckResult lResult = lCheck ? lCheck(lManufacturerId, lHardwareType, lVersion) : FlashValid;
+        if (lResult == FlashAllInvalid)
+            return;
+        _bau.deviceObject().hardwareType(lHardwareType);
+        _configured = (lResult == FlashValid);
+    }
+
+    // test helper: writes the device object image like ETS
+    void stubProgram(uint16_t iManufacturerId, const uint8_t *iHardwareType, uint16_t iVersion = 0)
+    {
+        uint8_t lImage[3 + LEN_HARDWARE_TYPE + 2];
+        uint8_t *lPos = pushByte(STUB_KNX_PROGRAMMED, lImage);
+        lPos = pushWord(iManufacturerId, lPos);
+        lPos = pushByteArray(iHardwareType, LEN_HARDWARE_TYPE, lPos);
+        pushWord(iVersion, lPos);
+        _platform.writeNonVolatileMemory(0, lImage, sizeof(lImage));
+        _platform.commitNonVolatileMemory();
+    }
+
+  private:
+    StubPlatform _platform;
+    BauStub _bau;
+    BeforeRestartCallback _beforeRestart = nullptr;
+    char _orderNumber[32] = {};
+    bool _configured = false;
+};
+
+inline KnxFacade knx;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// big endian and print helpers of the knx stack, which is not available in native unit tests
+#ifndef MIN
+#define MIN(a, b) ((a < b) ? (a) : (b))
+#endif
+
+inline void println(const char *iText)
+{
+    printf("%s\n", iText);
+}
+
+inline uint8_t *pushByte(uint8_t iByte, uint8_t *ioData)
+{
+    ioData[0] = iByte;
+    return ioData + 1;
+}
+
+inline uint8_t *pushWord(uint16_t iWord, uint8_t *ioData)
+{
+    ioData[0] = iWord >> 8;
+    ioData[1] = iWord & 0xFF;
+    return ioData + 2;
+}
+
+inline uint8_t *pushInt(uint32_t iInt, uint8_t *ioData)
+{
+    ioData[0] = iInt >> 24;
+    ioData[1] = (iInt >> 16) & 0xFF;
+    ioData[2] = (iInt >> 8) & 0xFF;
+    ioData[3] = iInt & 0xFF;
+    return ioData + 4;
+}
+
+inline uint8_t *pushByteArray(const uint8_t *iSource, uint32_t iLength, uint8_t *ioData)
+{
+    memcpy(ioData, iSource, iLength);
+    return ioData + iLength;
+}
+
+inline const uint8_t *popByte(uint8_t &oByte, const uint8_t *iData)
+{
+    oByte = iData[0];
+    return iData + 1;
+}
+
+inline const uint8_t *popWord(uint16_t &oWord, const uint8_t *iData)
+{
+    oWord = (iData[0] << 8) | iData[1];
+    return iData + 2;
+}
+
+inline const uint8_t *popInt(uint32_t &oInt, const uint8_t *iData)
+{
+    oInt = ((uint32_t)iData[0] << 24) | ((uint32_t)iData[1] << 16) | ((uint32_t)iData[2] << 8) | iData[3];
+    return iData + 4;
+}
@@ -0,0 +1,197 @@
+#include <unity.h>
+#include <string.h>
+#include "knx.h"
+#include "OpenKNX.h"
+#include "FlashUserData.h"
+#include "EepromManager.h"
+#include "HardwareDevices.h"
+#include "Benchmark.h"
+#include "Helper.h"
+
+/*********************************************
+ * Benchmark on the host: pio test -e native_benchmark
+ *
+ * Durations are taken from the emulated devices
+ * of test/stub (flash erase/program, I2C bytes,
+ * EEPROM write cycle, UART bytes), so they show
+ * how much device time an operation needs and
+ * how it scales, not the CPU time of the target.
+ * *******************************************/
+#ifndef OPENKNX_BENCHMARK
+#error "test_benchmark needs OPENKNX_BENCHMARK, run it with pio test -e native_benchmark"
+#endif
+
+#define TEST_OPENKNX_ID 0xA6
+#define TEST_APP_NUMBER 0x01
+#define TEST_APP_VERSION 0x12
+#define TEST_FIRMWARE_REVISION 3
+// runs of each measurement
+#define TEST_BENCHMARK_RUNS 10
+#define TEST_MODULE_SIZE 64
+#define TEST_MAX_MODULES 16
+
+static uint8_t sMagicWord[4] = {0x42, 0x4E, 0x43, 0x48};
+
+class BenchmarkModule : public IFlashUserData
+{
+  public:
+    uint8_t data[TEST_MODULE_SIZE];
+
+    void init(uint16_t iId)
+    {
+        _id = iId;
+        for (uint8_t lIndex = 0; lIndex < TEST_MODULE_SIZE; lIndex++)
+            data[lIndex] = iId + lIndex;
+    }
+    uint8_t *save(uint8_t *buffer) override
+    {
+        memcpy(buffer, data, TEST_MODULE_SIZE);
+        return buffer + TEST_MODULE_SIZE;
+    }
+    const uint8_t *restore(const uint8_t *buffer) override
+    {
+        memcpy(data, buffer, TEST_MODULE_SIZE);
+        return buffer + TEST_MODULE_SIZE;
+    }
+    uint16_t saveSize() override
+    {
+        return TEST_MODULE_SIZE;
+    }
+    uint16_t id() override
+    {
+        return _id;
+    }
+    bool isDirty() override
+    {
+        return true;
+    }
+    bool powerOn() override
+    {
+        return true;
+    }
+    const char *name() override
+    {
+        return "benchmark";
+    }
+
+  private:
+    uint16_t _id = 0;
+};
+
+static void program()
+{
+    const uint8_t lHardwareType[LEN_HARDWARE_TYPE] = {0x00, 0x00, TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, 0x00};
+    knx.stubProgram(0x00FA, lHardwareType);
+    OpenKNX::knxRead(TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, TEST_FIRMWARE_REVISION);
+}
+
+void setUp()
+{
+    knx.platform().stubErase();
+    program();
+    stubAdvanceMillis(1);
+}
+
+void tearDown() {}
+
+// boot probe of board hardware: EEPROM by I2C, NCN5130 by UART
+void test_boot_probe()
+{
+    Benchmark::reset();
+    TEST_ASSERT_TRUE(boardCheck());
+    TEST_ASSERT_TRUE(boardWithEEPROM());
+    TEST_ASSERT_TRUE(boardWithNCN5130());
+    Benchmark::boardCheck.print("boardCheck");
+    TEST_ASSERT_EQUAL_UINT32(1, Benchmark::boardCheck.count());
+}
+
+void test_knx_read()
+{
+    Benchmark::reset();
+    for (uint8_t lRun = 0; lRun < TEST_BENCHMARK_RUNS; lRun++)
+        OpenKNX::knxRead(TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, TEST_FIRMWARE_REVISION);
+    Benchmark::knxRead.print("knxRead");
+    TEST_ASSERT_EQUAL_UINT32(TEST_BENCHMARK_RUNS, Benchmark::knxRead.count());
+}
+
+// full saves and restores with a growing number of modules, erased flash bytes show the wear per save
+void test_save_restore_scaling()
+{
+    for (uint8_t lModules = 1; lModules <= TEST_MAX_MODULES; lModules *= 4)
+    {
+        knx.platform().stubErase();
+        program();
+        FlashUserData lFlash;
+        BenchmarkModule lModule[TEST_MAX_MODULES];
+        for (uint8_t lIndex = 0; lIndex < lModules; lIndex++)
+        {
+            lModule[lIndex].init(0x0100 + lIndex);
+            lFlash.first(&lModule[lIndex]);
+        }
+        lFlash.readFlash();
+        printDebug("%u modules of %u bytes:\n", lModules, TEST_MODULE_SIZE);
+        uint32_t lErases = knx.platform().stubErases();
+        lFlash.benchmark(TEST_BENCHMARK_RUNS);
+        uint32_t lErased = (knx.platform().stubErases() - lErases) * STUB_FLASH_BLOCK_SIZE / TEST_BENCHMARK_RUNS;
+        printDebug("flash erased     %8lu bytes/save\n", (unsigned long)lErased);
+        TEST_ASSERT_EQUAL_UINT32(TEST_BENCHMARK_RUNS, Benchmark::flashSave.count());
+        TEST_ASSERT_EQUAL_UINT32(TEST_BENCHMARK_RUNS, Benchmark::flashRestore.count());
+        TEST_ASSERT_TRUE(Benchmark::flashSave.bytes() >= (uint32_t)lModules * TEST_MODULE_SIZE);
+        // each erased block takes its erase and program time
+        TEST_ASSERT_TRUE(Benchmark::flashSave.average() >= lErased / STUB_FLASH_BLOCK_SIZE * (STUB_FLASH_ERASE_TIME + STUB_FLASH_PROGRAM_TIME));
+    }
+}
+
+// the time from SAVE-Interrupt to committed flash is what a hold-up capacitor has to cover
+void test_save_interrupt()
+{
+    FlashUserData lFlash;
+    BenchmarkModule lModule[TEST_MAX_MODULES];
+    for (uint8_t lIndex = 0; lIndex < TEST_MAX_MODULES; lIndex++)
+    {
+        lModule[lIndex].init(0x0100 + lIndex);
+        lFlash.first(&lModule[lIndex]);
+    }
+    lFlash.readFlash();
+    Benchmark::reset();
+    for (uint8_t lRun = 0; lRun < TEST_BENCHMARK_RUNS; lRun++)
+    {
+        lModule[lRun % TEST_MAX_MODULES].data[0]++;
+        FlashUserData::onSafePinInterruptHandler();
+        lFlash.loop();
+    }
+    Benchmark::powerOff.print("savePower");
+    Benchmark::flashSave.print("flash save");
+    Benchmark::powerOn.print("restorePower");
+    // restorePower() runs with bus voltage back, so it does not count
+    printDebug("hold-up time     max %8lu us\n", (unsigned long)(Benchmark::powerOff.maximum() + Benchmark::flashSave.maximum()));
+    TEST_ASSERT_EQUAL_UINT32(TEST_BENCHMARK_RUNS, Benchmark::flashSave.count());
+}
+
+// each page write waits for the write cycle of the previous one
+void test_eeprom_pages()
+{
+    EepromManager lRegion(128, 64, sMagicWord);
+    uint16_t lStart = lRegion.startAddress();
+    uint8_t lData[64 * EEPROM_PAGE_SIZE];
+    for (uint16_t lIndex = 0; lIndex < sizeof(lData); lIndex++)
+        lData[lIndex] = lIndex;
+    Benchmark::reset();
+    TEST_ASSERT_TRUE(lRegion.write(lStart, lData, sizeof(lData)));
+    TEST_ASSERT_TRUE(lRegion.read(lStart, lData, sizeof(lData)));
+    Benchmark::eepromPageWrite.print("EEPROM page");
+    Benchmark::eepromRead.print("EEPROM read");
+    TEST_ASSERT_TRUE(Benchmark::eepromPageWrite.count() > 0);
+    TEST_ASSERT_TRUE(Benchmark::eepromPageWrite.average() >= STUB_EEPROM_WRITE_TIME);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_probe);
+    RUN_TEST(test_knx_read);
+    RUN_TEST(test_save_restore_scaling);
+    RUN_TEST(test_save_interrupt);
+    RUN_TEST(test_eeprom_pages);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <unity.h>
+#include <string.h>
+#include <Wire.h>
+#include "EepromManager.h"
+
+// each test uses its own pages, the read cache of EepromManager is shared by all instances
+static uint8_t sMagicWord[4] = {0x45, 0x54, 0x53, 0x54};
+static uint8_t sCallbacks = 0;
+static bool sCallbackResult = false;
+
+static void onWritten(bool iSuccess)
+{
+    sCallbacks++;
+    sCallbackResult = iSuccess;
+}
+
+static void fill(uint8_t *oData, uint16_t iLength, uint8_t iSeed)
+{
+    for (uint16_t lIndex = 0; lIndex < iLength; lIndex++)
+        oData[lIndex] = iSeed + lIndex;
+}
+
+static void drain()
+{
+    while (!EepromManager::idle())
+        EepromManager::loop();
+    EepromManager::loop();
+}
+
+void setUp()
+{
+    sCallbacks = 0;
+    sCallbackResult = false;
+    EepromManager::skipUnchanged(false);
+}
+
+void tearDown() {}
+
+// data crossing device pages is split into transactions, which do not cross a device page
+void test_write_read()
+{
+    EepromManager lRegion(0, 8, sMagicWord);
+    uint8_t lData[100];
+    uint8_t lRead[100];
+    fill(lData, sizeof(lData), 1);
+    uint32_t lWrites = Wire.stubWrites();
+    TEST_ASSERT_TRUE(lRegion.write(50, lData, sizeof(lData)));
+    TEST_ASSERT_EQUAL_UINT32(lWrites + 4, Wire.stubWrites());
+    TEST_ASSERT_TRUE(lRegion.read(50, lRead, sizeof(lRead)));
+    TEST_ASSERT_TRUE(memcmp(lData, lRead, sizeof(lData)) == 0);
+    TEST_ASSERT_TRUE(memcmp(lData, Wire.stubMemory() + 50, sizeof(lData)) == 0);
+    // accesses outside of the region are rejected
+    TEST_ASSERT_FALSE(lRegion.write(8 * EEPROM_PAGE_SIZE - 1, lData, 2));
+    TEST_ASSERT_FALSE(lRegion.read(8 * EEPROM_PAGE_SIZE - 1, lRead, 2));
+}
+
+// callbacks are called by loop(), not by a synchronous access waiting for the write cycle
+void test_async_callback()
+{
+    EepromManager lRegion(8, 8, sMagicWord);
+    uint16_t lStart = lRegion.startAddress();
+    uint8_t lData[80];
+    uint8_t lRead[80];
+    fill(lData, sizeof(lData), 7);
+    TEST_ASSERT_TRUE(lRegion.writeAsync(lStart, lData, sizeof(lData), onWritten));
+    TEST_ASSERT_FALSE(EepromManager::idle());
+    while (!EepromManager::idle())
+        EepromManager::process();
+    TEST_ASSERT_TRUE(lRegion.read(lStart, lRead, sizeof(lRead)));
+    TEST_ASSERT_EQUAL_UINT8(0, sCallbacks);
+    EepromManager::loop();
+    TEST_ASSERT_EQUAL_UINT8(1, sCallbacks);
+    TEST_ASSERT_TRUE(sCallbackResult);
+    TEST_ASSERT_TRUE(memcmp(lData, lRead, sizeof(lData)) == 0);
+}
+
+// writes with callback are rejected, as long as the completion queue could overflow
+void test_pending_callbacks()
+{
+    EepromManager lRegion(16, 16, sMagicWord);
+    uint16_t lStart = lRegion.startAddress();
+    uint8_t lData[4] = {1, 2, 3, 4};
+    for (uint16_t lCount = 0; lCount < EEPROM_COMPLETION_QUEUE_SIZE; lCount++)
+    {
+        TEST_ASSERT_TRUE(lRegion.writeAsync(lStart + 4 * (lCount % 16), lData, sizeof(lData), onWritten));
+        while (!EepromManager::idle())
+            EepromManager::process();
+    }
+    TEST_ASSERT_FALSE(lRegion.writeAsync(lStart, lData, sizeof(lData), onWritten));
+    TEST_ASSERT_TRUE(lRegion.writeAsync(lStart, lData, sizeof(lData)));
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(EEPROM_COMPLETION_QUEUE_SIZE, sCallbacks);
+    TEST_ASSERT_TRUE(lRegion.writeAsync(lStart, lData, sizeof(lData), onWritten));
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(EEPROM_COMPLETION_QUEUE_SIZE + 1, sCallbacks);
+}
+
+// an interrupted session keeps the image of the last committed session
+void test_double_buffered()
+{
+    uint8_t lData[40];
+    uint8_t lRead[40];
+    {
+        EepromManager lRegion(32, 32, sMagicWord, true);
+        uint16_t lStart = lRegion.startAddress();
+        TEST_ASSERT_FALSE(lRegion.isValid());
+        TEST_ASSERT_TRUE(lRegion.beginWriteSession());
+        fill(lData, sizeof(lData), 3);
+        TEST_ASSERT_TRUE(lRegion.write(lStart + 10, lData, sizeof(lData)));
+        lRegion.endWriteSession();
+        TEST_ASSERT_TRUE(lRegion.isValid());
+        TEST_ASSERT_TRUE(lRegion.beginWriteSession());
+        fill(lData, sizeof(lData), 9);
+        TEST_ASSERT_TRUE(lRegion.write(lStart + 10, lData, sizeof(lData)));
+    }
+    // reboot without commit
+    {
+        EepromManager lRegion(32, 32, sMagicWord, true);
+        uint16_t lStart = lRegion.startAddress();
+        TEST_ASSERT_TRUE(lRegion.isValid());
+        TEST_ASSERT_TRUE(lRegion.read(lStart + 10, lRead, sizeof(lRead)));
+        fill(lData, sizeof(lData), 3);
+        TEST_ASSERT_TRUE(memcmp(lData, lRead, sizeof(lData)) == 0);
+        // a partial write keeps the other bytes of the image
+        TEST_ASSERT_TRUE(lRegion.beginWriteSession());
+        uint8_t lByte = 0xEE;
+        TEST_ASSERT_TRUE(lRegion.write(lStart + 20, &lByte, 1));
+        lRegion.endWriteSession();
+        lData[10] = lByte;
+        TEST_ASSERT_TRUE(lRegion.read(lStart + 10, lRead, sizeof(lRead)));
+        TEST_ASSERT_TRUE(memcmp(lData, lRead, sizeof(lData)) == 0);
+    }
+}
+
+// unchanged pages are not written again
+void test_skip_unchanged()
+{
+    EepromManager lRegion(64, 8, sMagicWord);
+    uint16_t lStart = lRegion.startAddress();
+    uint8_t lData[64];
+    fill(lData, sizeof(lData), 5);
+    EepromManager::skipUnchanged(true);
+    TEST_ASSERT_TRUE(lRegion.writeAsync(lStart, lData, sizeof(lData), onWritten));
+    drain();
+    uint32_t lWrites = Wire.stubWrites();
+    TEST_ASSERT_TRUE(lRegion.writeAsync(lStart, lData, sizeof(lData), onWritten));
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(lWrites, Wire.stubWrites());
+    TEST_ASSERT_EQUAL_UINT8(2, sCallbacks);
+    TEST_ASSERT_TRUE(sCallbackResult);
+    lData[33] ^= 0xFF;
+    TEST_ASSERT_TRUE(lRegion.writeAsync(lStart, lData, sizeof(lData)));
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(lWrites + 1, Wire.stubWrites());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_write_read);
+    RUN_TEST(test_async_callback);
+    RUN_TEST(test_pending_callbacks);
+    RUN_TEST(test_double_buffered);
+    RUN_TEST(test_skip_unchanged);
+    return UNITY_END();
+}
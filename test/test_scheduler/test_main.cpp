@@ -0,0 +1,126 @@
+#include <unity.h>
+#include <vector>
+#include "Scheduler.h"
+
+static std::vector<int> sRuns;
+
+static void task(void *iContext)
+{
+    sRuns.push_back((int)(intptr_t)iContext);
+}
+
+static void runLoop(Scheduler &ioScheduler, uint32_t iMillis)
+{
+    stubAdvanceMillis(iMillis);
+    ioScheduler.loop();
+}
+
+void setUp()
+{
+    sRuns.clear();
+}
+
+void tearDown() {}
+
+void test_once()
+{
+    Scheduler lScheduler;
+    uint32_t lId = lScheduler.once(10, task, (void *)1);
+    TEST_ASSERT_NOT_EQUAL(SCHEDULER_NO_TASK, lId);
+    runLoop(lScheduler, 9);
+    TEST_ASSERT_EQUAL(0, sRuns.size());
+    runLoop(lScheduler, 2);
+    TEST_ASSERT_EQUAL(1, sRuns.size());
+    runLoop(lScheduler, 20);
+    TEST_ASSERT_EQUAL(1, sRuns.size());
+    TEST_ASSERT_FALSE(lScheduler.cancel(lId));
+}
+
+// the id of a cancelled task does not cancel the next task in the same slot
+void test_stale_id()
+{
+    Scheduler lScheduler;
+    uint32_t lOld = lScheduler.once(10, task, (void *)1);
+    TEST_ASSERT_TRUE(lScheduler.cancel(lOld));
+    uint32_t lNew = lScheduler.once(10, task, (void *)2);
+    TEST_ASSERT_EQUAL_UINT32(lOld & 0xFF, lNew & 0xFF);
+    TEST_ASSERT_NOT_EQUAL(lOld, lNew);
+    TEST_ASSERT_FALSE(lScheduler.cancel(lOld));
+    TEST_ASSERT_FALSE(lScheduler.cancel(SCHEDULER_NO_TASK));
+    runLoop(lScheduler, 11);
+    TEST_ASSERT_EQUAL(1, sRuns.size());
+    TEST_ASSERT_EQUAL(2, sRuns[0]);
+}
+
+// overdue tasks run by priority, then by due time, at most SCHEDULER_TASKS_PER_LOOP per loop()
+void test_priority()
+{
+    Scheduler lScheduler;
+    lScheduler.once(5, task, (void *)10, 0);
+    lScheduler.once(7, task, (void *)11, 0);
+    lScheduler.once(9, task, (void *)12, 5);
+    runLoop(lScheduler, 20);
+    TEST_ASSERT_EQUAL(SCHEDULER_TASKS_PER_LOOP, sRuns.size());
+    TEST_ASSERT_EQUAL(12, sRuns[0]);
+    TEST_ASSERT_EQUAL(10, sRuns[1]);
+    runLoop(lScheduler, 0);
+    TEST_ASSERT_EQUAL(3, sRuns.size());
+    TEST_ASSERT_EQUAL(11, sRuns[2]);
+}
+
+// periodic tasks keep their phase, even if loop() is called late
+void test_every()
+{
+    Scheduler lScheduler;
+    uint32_t lId = lScheduler.every(10, task);
+    for (uint8_t i = 0; i < 10; i++)
+        runLoop(lScheduler, 3);
+    TEST_ASSERT_EQUAL(3, sRuns.size());
+    // missed runs are skipped
+    runLoop(lScheduler, 100);
+    TEST_ASSERT_EQUAL(4, sRuns.size());
+    TEST_ASSERT_TRUE(lScheduler.cancel(lId));
+    runLoop(lScheduler, 100);
+    TEST_ASSERT_EQUAL(4, sRuns.size());
+}
+
+// every(0) runs in each loop() and takes turns with other tasks of the same priority
+void test_every_loop()
+{
+    Scheduler lScheduler;
+    uint32_t lId = lScheduler.every(0, task, (void *)20);
+    runLoop(lScheduler, 0);
+    runLoop(lScheduler, 0);
+    runLoop(lScheduler, 0);
+    TEST_ASSERT_EQUAL(3, sRuns.size());
+    lScheduler.every(10, task, (void *)21);
+    runLoop(lScheduler, 10);
+    TEST_ASSERT_EQUAL(5, sRuns.size());
+    TEST_ASSERT_TRUE(lScheduler.cancel(lId));
+    runLoop(lScheduler, 0);
+    TEST_ASSERT_EQUAL(5, sRuns.size());
+}
+
+void test_timers()
+{
+    Scheduler lScheduler;
+    WheelTimer lTimer(task, (void *)30);
+    lScheduler.timers().startMillis(lTimer, 5);
+    TEST_ASSERT_TRUE(lTimer.running());
+    runLoop(lScheduler, 6);
+    TEST_ASSERT_FALSE(lTimer.running());
+    TEST_ASSERT_EQUAL(1, sRuns.size());
+    TEST_ASSERT_EQUAL(30, sRuns[0]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_once);
+    RUN_TEST(test_stale_id);
+    RUN_TEST(test_priority);
+    RUN_TEST(test_every);
+    RUN_TEST(test_every_loop);
+    RUN_TEST(test_timers);
+    return UNITY_END();
+}
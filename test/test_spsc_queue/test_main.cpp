@@ -0,0 +1,100 @@
+#include <unity.h>
+#include <thread>
+#include "SpscQueue.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_empty()
+{
+    SpscQueue<uint32_t, 4> lQueue;
+    uint32_t lItem = 0;
+    TEST_ASSERT_TRUE(lQueue.empty());
+    TEST_ASSERT_EQUAL_UINT16(4, lQueue.free());
+    TEST_ASSERT_FALSE(lQueue.pop(lItem));
+}
+
+void test_fifo()
+{
+    SpscQueue<uint32_t, 4> lQueue;
+    uint32_t lItem = 0;
+    TEST_ASSERT_TRUE(lQueue.push(1));
+    TEST_ASSERT_TRUE(lQueue.push(2));
+    TEST_ASSERT_FALSE(lQueue.empty());
+    TEST_ASSERT_EQUAL_UINT16(2, lQueue.free());
+    TEST_ASSERT_TRUE(lQueue.pop(lItem));
+    TEST_ASSERT_EQUAL_UINT32(1, lItem);
+    TEST_ASSERT_TRUE(lQueue.pop(lItem));
+    TEST_ASSERT_EQUAL_UINT32(2, lItem);
+    TEST_ASSERT_TRUE(lQueue.empty());
+}
+
+void test_full()
+{
+    SpscQueue<uint32_t, 4> lQueue;
+    uint32_t lItem = 0;
+    for (uint32_t i = 0; i < 4; i++)
+        TEST_ASSERT_TRUE(lQueue.push(i));
+    TEST_ASSERT_EQUAL_UINT16(0, lQueue.free());
+    TEST_ASSERT_FALSE(lQueue.push(4));
+    TEST_ASSERT_TRUE(lQueue.pop(lItem));
+    TEST_ASSERT_EQUAL_UINT32(0, lItem);
+    TEST_ASSERT_TRUE(lQueue.push(4));
+}
+
+// head and tail are 16 bit counters, they have to wrap around without losing items
+void test_wrap_around()
+{
+    SpscQueue<uint32_t, 4> lQueue;
+    uint32_t lItem = 0;
+    for (uint32_t i = 0; i < 70000; i++)
+    {
+        TEST_ASSERT_TRUE(lQueue.push(i));
+        TEST_ASSERT_TRUE(lQueue.push(i + 1));
+        TEST_ASSERT_TRUE(lQueue.pop(lItem));
+        TEST_ASSERT_EQUAL_UINT32(i, lItem);
+        TEST_ASSERT_TRUE(lQueue.pop(lItem));
+        TEST_ASSERT_EQUAL_UINT32(i + 1, lItem);
+    }
+    TEST_ASSERT_TRUE(lQueue.empty());
+}
+
+// producer and consumer in two threads like the two cores: no item is lost, duplicated or reordered
+void test_two_threads()
+{
+    static SpscQueue<uint32_t, 16> sQueue;
+    const uint32_t lCount = 1000000;
+    std::thread lProducer([&]() {
+        for (uint32_t i = 0; i < lCount; i++)
+            while (!sQueue.push(i))
+                std::this_thread::yield();
+    });
+    uint32_t lExpected = 0;
+    bool lOrdered = true;
+    while (lExpected < lCount)
+    {
+        uint32_t lItem = 0;
+        if (!sQueue.pop(lItem))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        lOrdered = lOrdered && lItem == lExpected;
+        lExpected++;
+    }
+    lProducer.join();
+    TEST_ASSERT_TRUE(lOrdered);
+    TEST_ASSERT_TRUE(sQueue.empty());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_fifo);
+    RUN_TEST(test_full);
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_two_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,256 @@
+#include <unity.h>
+#include <string.h>
+#include "knx.h"
+#include "OpenKNX.h"
+#include "FlashUserData.h"
+#include "FlashUserDataWriter.h"
+
+// application of the test firmware, hardware type is 0x00 00 Ap nn vv 00
+#define TEST_OPENKNX_ID 0xA6
+#define TEST_APP_NUMBER 0x01
+#define TEST_APP_VERSION 0x12
+#define TEST_FIRMWARE_REVISION 3
+
+static const uint8_t sMagicWord[USERDATA_METADATA_SIZE] = {0xDA, 0x77, 0x6E, 0x84};
+
+class TestModule : public IFlashUserData
+{
+  public:
+    uint8_t data[24];
+    uint8_t restored = 0;
+    bool dirty = true;
+
+    TestModule(const char *iName, uint16_t iId, uint8_t iSize) : _name(iName), _id(iId), _size(iSize)
+    {
+        set(0);
+    }
+    void set(uint8_t iSeed)
+    {
+        for (uint8_t lIndex = 0; lIndex < _size; lIndex++)
+            data[lIndex] = iSeed + lIndex;
+        dirty = true;
+    }
+    uint8_t *save(uint8_t *buffer) override
+    {
+        memcpy(buffer, data, _size);
+        dirty = false;
+        return buffer + _size;
+    }
+    const uint8_t *restore(const uint8_t *buffer) override
+    {
+        memcpy(data, buffer, _size);
+        restored++;
+        dirty = false;
+        return buffer + _size;
+    }
+    uint16_t saveSize() override
+    {
+        return _size;
+    }
+    uint16_t id() override
+    {
+        return _id;
+    }
+    bool isDirty() override
+    {
+        return dirty;
+    }
+    bool powerOn() override
+    {
+        return true;
+    }
+    const char *name() override
+    {
+        return _name;
+    }
+
+  private:
+    const char *_name;
+    uint16_t _id;
+    uint8_t _size;
+};
+
+// saves its state by saveStream()
+class StreamModule : public TestModule
+{
+  public:
+    StreamModule() : TestModule("stream", 0x0300, 20) {}
+    bool streamsSave() override
+    {
+        return true;
+    }
+    bool saveStream(FlashUserDataWriter &writer) override
+    {
+        for (uint8_t lIndex = 0; lIndex < saveSize(); lIndex += 4)
+            writer.writeInt((data[lIndex] << 24) | (data[lIndex + 1] << 16) | (data[lIndex + 2] << 8) | data[lIndex + 3]);
+        dirty = false;
+        return true;
+    }
+};
+
+// firmware with its modules, each instance is a boot of the device
+class Device
+{
+  public:
+    FlashUserData flash;
+    TestModule first = TestModule("first", 0x0100, 16);
+    TestModule legacy = TestModule("legacy", 0, 8); // without id, stored by position
+    StreamModule stream;
+
+    Device()
+    {
+        flash.first(&stream);
+        flash.first(&legacy);
+        flash.first(&first);
+        OpenKNX::knxRead(TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, TEST_FIRMWARE_REVISION);
+        flash.readFlash();
+    }
+};
+
+// saves are throttled, so tests wait for the interval before each save
+static void save()
+{
+    stubAdvanceMillis(USERDATA_SAVE_INTERVAL);
+    TableObject::beforeTablesUnloadCallback()();
+}
+
+static void program(uint8_t iAppVersion = TEST_APP_VERSION)
+{
+    const uint8_t lHardwareType[LEN_HARDWARE_TYPE] = {0x00, 0x00, TEST_OPENKNX_ID, TEST_APP_NUMBER, iAppVersion, 0x00};
+    knx.stubProgram(0x00FA, lHardwareType);
+}
+
+// sector of the current generation, -1 if there is none
+static int16_t currentSector()
+{
+    FlashUserDataRing lRing;
+    lRing.init(knx.platform().getNonVolatileMemoryStart(), knx.platform().getNonVolatileMemorySize());
+    return lRing.find(sMagicWord) ? lRing.sector() : -1;
+}
+
+void setUp()
+{
+    knx.platform().stubErase();
+    program();
+    stubAdvanceMillis(1);
+}
+
+void tearDown() {}
+
+// the device is configured just with the programmed application
+void test_knx_read()
+{
+    const uint8_t lHardwareType[LEN_HARDWARE_TYPE] = {0x00, 0x00, TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, 0x00};
+    OpenKNX::knxRead(TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, TEST_FIRMWARE_REVISION, "TEST-1");
+    TEST_ASSERT_TRUE(knx.configured());
+    TEST_ASSERT_TRUE(memcmp(knx.bau().deviceObject().hardwareType(), lHardwareType, LEN_HARDWARE_TYPE) == 0);
+    TEST_ASSERT_EQUAL_UINT16((TEST_FIRMWARE_REVISION << 11) | 0x0042, knx.bau().deviceObject().version());
+    TEST_ASSERT_TRUE(strcmp(knx.orderNumber(), "TEST-1") == 0);
+    program(TEST_APP_VERSION + 1);
+    OpenKNX::knxRead(TEST_OPENKNX_ID, TEST_APP_NUMBER, TEST_APP_VERSION, TEST_FIRMWARE_REVISION);
+    TEST_ASSERT_FALSE(knx.configured());
+    // the hardware type of the firmware is set again
+    TEST_ASSERT_TRUE(memcmp(knx.bau().deviceObject().hardwareType(), lHardwareType, LEN_HARDWARE_TYPE) == 0);
+}
+
+void test_restore_after_reboot()
+{
+    {
+        Device lDevice;
+        TEST_ASSERT_EQUAL_INT16(-1, currentSector());
+        lDevice.first.set(10);
+        lDevice.legacy.set(20);
+        lDevice.stream.set(30);
+        save();
+        TEST_ASSERT_EQUAL_INT16(0, currentSector());
+    }
+    knx.platform().stubReboot();
+    Device lDevice;
+    TEST_ASSERT_EQUAL_UINT8(1, lDevice.first.restored);
+    TEST_ASSERT_EQUAL_UINT8(1, lDevice.legacy.restored);
+    TEST_ASSERT_EQUAL_UINT8(1, lDevice.stream.restored);
+    TestModule lExpected("expected", 0, 20);
+    lExpected.set(10);
+    TEST_ASSERT_TRUE(memcmp(lExpected.data, lDevice.first.data, 16) == 0);
+    lExpected.set(20);
+    TEST_ASSERT_TRUE(memcmp(lExpected.data, lDevice.legacy.data, 8) == 0);
+    lExpected.set(30);
+    TEST_ASSERT_TRUE(memcmp(lExpected.data, lDevice.stream.data, 20) == 0);
+}
+
+// a save of dirty, but unchanged modules does not erase or program flash
+void test_skip_unchanged()
+{
+    Device lDevice;
+    lDevice.first.set(10);
+    save();
+    uint32_t lErases = knx.platform().stubErases();
+    int16_t lSector = currentSector();
+    lDevice.first.set(10);
+    lDevice.stream.dirty = true;
+    save();
+    TEST_ASSERT_EQUAL_UINT32(lErases, knx.platform().stubErases());
+    TEST_ASSERT_EQUAL_INT16(lSector, currentSector());
+    lDevice.first.set(11);
+    save();
+    TEST_ASSERT_TRUE(knx.platform().stubErases() > lErases);
+    TEST_ASSERT_NOT_EQUAL(lSector, currentSector());
+}
+
+// each generation starts at the sector after the previous one, so all sectors are written in turn
+void test_sector_rotation()
+{
+    Device lDevice;
+    uint16_t lSectors = FlashUserDataRing::sectorsOf(USERDATA_RECORD_SIZE(16) + USERDATA_RECORD_SIZE(8) + USERDATA_RECORD_SIZE(20));
+    int16_t lExpected = 0;
+    for (uint8_t lSave = 0; lSave < 2 * FlashUserDataRing::sectors(); lSave++)
+    {
+        lDevice.first.set(lSave);
+        save();
+        TEST_ASSERT_EQUAL_INT16(lExpected, currentSector());
+        lExpected += lSectors;
+        if (lExpected + lSectors > FlashUserDataRing::sectors())
+            lExpected = 0;
+    }
+}
+
+// the save of a SAVE-Interrupt is not throttled by USERDATA_SAVE_INTERVAL
+void test_save_interrupt()
+{
+    {
+        Device lDevice;
+        lDevice.first.set(10);
+        save();
+        lDevice.first.set(40);
+        FlashUserData::onSafePinInterruptHandler();
+        lDevice.flash.loop();
+        TEST_ASSERT_EQUAL_UINT32(0, knx.platform().stubRestarts());
+    }
+    knx.platform().stubReboot();
+    Device lDevice;
+    TestModule lExpected("expected", 0, 16);
+    lExpected.set(40);
+    TEST_ASSERT_TRUE(memcmp(lExpected.data, lDevice.first.data, 16) == 0);
+}
+
+// without configuration nothing is saved
+void test_not_configured()
+{
+    program(TEST_APP_VERSION + 1);
+    Device lDevice;
+    TEST_ASSERT_FALSE(knx.configured());
+    save();
+    TEST_ASSERT_EQUAL_INT16(-1, currentSector());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_knx_read);
+    RUN_TEST(test_restore_after_reboot);
+    RUN_TEST(test_skip_unchanged);
+    RUN_TEST(test_sector_rotation);
+    RUN_TEST(test_save_interrupt);
+    RUN_TEST(test_not_configured);
+    return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <string.h>
+#include "knx/bits.h"
+#include "Helper.h"
+#include "FlashUserDataRing.h"
+
+// erased flash, the ring is placed at its end
+#define FLASH_SIZE 8192
+
+static uint8_t sFlash[FLASH_SIZE];
+static const uint8_t sMagicWord[USERDATA_METADATA_SIZE] = {0xAE, 0x49, 0xD2, 0x9F};
+static FlashUserDataRing sRing;
+
+// writes a record like FlashUserData::writeRecord(), returns the position after it
+static uint8_t *writeRecord(uint8_t *iPos, uint16_t iId, uint8_t iVersion, const uint8_t *iData, uint16_t iLength)
+{
+    iPos = pushWord(iId, iPos);
+    iPos = pushByte(iVersion, iPos);
+    iPos = pushWord(iLength, iPos);
+    iPos = pushByteArray(iData, iLength, iPos);
+    return pushWord(crc16(iData, iLength), iPos);
+}
+
+// writes a generation with two records to iSector, without trailer if iComplete is false
+static uint32_t writeGeneration(uint16_t iSector, uint32_t iGeneration, bool iComplete = true)
+{
+    const uint8_t lData1[3] = {1, 2, 3};
+    const uint8_t lData2[2] = {4, 5};
+    uint8_t *lStart = sFlash + sRing.sectorStart(iSector);
+    uint8_t *lPos = writeRecord(lStart + USERDATA_HEADER_SIZE, 0x0101, 1, lData1, sizeof(lData1));
+    lPos = writeRecord(lPos, 0x0202, 2, lData2, sizeof(lData2));
+    uint32_t lLength = lPos - (lStart + USERDATA_HEADER_SIZE);
+    uint8_t *lHeader = pushByteArray(sMagicWord, USERDATA_METADATA_SIZE, lStart);
+    lHeader = pushInt(iGeneration, lHeader);
+    lHeader = pushInt(lLength, lHeader);
+    pushInt(2, lHeader);
+    if (!iComplete)
+        return lLength;
+    lPos = pushInt(iGeneration, lPos);
+    pushByteArray(sMagicWord, USERDATA_METADATA_SIZE, lPos);
+    return lLength;
+}
+
+void setUp()
+{
+    memset(sFlash, 0xFF, sizeof(sFlash));
+    TEST_ASSERT_TRUE(sRing.init(sFlash, FLASH_SIZE));
+}
+
+void tearDown() {}
+
+void test_geometry()
+{
+    TEST_ASSERT_EQUAL_UINT32(FLASH_SIZE - USERDATA_SECTOR_COUNT * USERDATA_SECTOR_SIZE, sRing.sectorStart(0));
+    TEST_ASSERT_EQUAL_UINT32(sRing.sectorStart(0) + USERDATA_SECTOR_SIZE, sRing.sectorStart(1));
+    TEST_ASSERT_EQUAL_UINT16(1, FlashUserDataRing::sectorsOf(0));
+    TEST_ASSERT_EQUAL_UINT16(1, FlashUserDataRing::sectorsOf(USERDATA_SECTOR_SIZE - USERDATA_HEADER_SIZE - USERDATA_TRAILER_SIZE));
+    TEST_ASSERT_EQUAL_UINT16(2, FlashUserDataRing::sectorsOf(USERDATA_SECTOR_SIZE - USERDATA_HEADER_SIZE - USERDATA_TRAILER_SIZE + 1));
+    // a generation can take up to half of the ring
+    TEST_ASSERT_TRUE(FlashUserDataRing::fits(FlashUserDataRing::maxSize() - USERDATA_HEADER_SIZE - USERDATA_TRAILER_SIZE));
+    TEST_ASSERT_FALSE(FlashUserDataRing::fits(FlashUserDataRing::maxSize() - USERDATA_HEADER_SIZE - USERDATA_TRAILER_SIZE + 1));
+    // the ring must not take more than half of the memory
+    FlashUserDataRing lRing;
+    TEST_ASSERT_FALSE(lRing.init(sFlash, USERDATA_SECTOR_COUNT * USERDATA_SECTOR_SIZE));
+}
+
+void test_empty_flash()
+{
+    TEST_ASSERT_FALSE(sRing.find(sMagicWord));
+    TEST_ASSERT_EQUAL_UINT32(0, sRing.generation());
+    TEST_ASSERT_EQUAL_UINT16(0, sRing.nextSector(0));
+    TEST_ASSERT_NULL(sRing.findRecord(0x0101, 1, 3));
+}
+
+void test_records()
+{
+    writeGeneration(0, 1);
+    TEST_ASSERT_TRUE(sRing.find(sMagicWord));
+    const uint8_t *lRecord = sRing.findRecord(0x0202, 2, 2);
+    TEST_ASSERT_NOT_NULL(lRecord);
+    uint16_t lId = 0;
+    uint8_t lVersion = 0;
+    uint16_t lLength = 0;
+    const uint8_t *lData = FlashUserDataRing::recordData(lRecord, lId, lVersion, lLength);
+    TEST_ASSERT_EQUAL_UINT16(0x0202, lId);
+    TEST_ASSERT_EQUAL_UINT8(2, lVersion);
+    TEST_ASSERT_EQUAL_UINT16(2, lLength);
+    TEST_ASSERT_EQUAL_UINT8(4, lData[0]);
+    TEST_ASSERT_TRUE(FlashUserDataRing::checkRecord(lData, lLength));
+    // other version or length, unknown id
+    TEST_ASSERT_NULL(sRing.findRecord(0x0202, 3, 2));
+    TEST_ASSERT_NULL(sRing.findRecord(0x0202, 2, 3));
+    TEST_ASSERT_NULL(sRing.findRecord(0x0303, 1, 3));
+}
+
+void test_record_crc()
+{
+    writeGeneration(0, 1);
+    TEST_ASSERT_TRUE(sRing.find(sMagicWord));
+    const uint8_t *lRecord = sRing.findRecord(0x0101, 1, 3);
+    TEST_ASSERT_NOT_NULL(lRecord);
+    sFlash[lRecord - sFlash + USERDATA_RECORD_HEADER_SIZE] ^= 0x01;
+    TEST_ASSERT_NULL(sRing.findRecord(0x0101, 1, 3));
+    TEST_ASSERT_NOT_NULL(sRing.findRecord(0x0202, 2, 2));
+}
+
+void test_newest_generation()
+{
+    writeGeneration(0, 7);
+    writeGeneration(1, 8);
+    TEST_ASSERT_TRUE(sRing.find(sMagicWord));
+    TEST_ASSERT_EQUAL_UINT32(8, sRing.generation());
+    TEST_ASSERT_EQUAL_UINT16(1, sRing.sector());
+    TEST_ASSERT_EQUAL_UINT16(2, sRing.nextSector(sRing.length()));
+}
+
+// a generation without trailer (power loss during save) is ignored, the previous one stays valid
+void test_incomplete_generation()
+{
+    writeGeneration(0, 7);
+    writeGeneration(1, 8, false);
+    TEST_ASSERT_TRUE(sRing.find(sMagicWord));
+    TEST_ASSERT_EQUAL_UINT32(7, sRing.generation());
+    TEST_ASSERT_EQUAL_UINT16(0, sRing.sector());
+    TEST_ASSERT_EQUAL_UINT16(1, sRing.nextSector(sRing.length()));
+}
+
+// generations are written to all sectors in turn and never overlap the current one
+void test_next_sector()
+{
+    uint32_t lLength = writeGeneration(0, 1);
+    TEST_ASSERT_TRUE(sRing.find(sMagicWord));
+    for (uint32_t lGeneration = 2; lGeneration < 2u + 2 * FlashUserDataRing::sectors(); lGeneration++)
+    {
+        uint16_t lSector = sRing.nextSector(lLength);
+        TEST_ASSERT_EQUAL_UINT16((lGeneration - 1) % FlashUserDataRing::sectors(), lSector);
+        writeGeneration(lSector, lGeneration);
+        TEST_ASSERT_TRUE(sRing.find(sMagicWord));
+        TEST_ASSERT_EQUAL_UINT32(lGeneration, sRing.generation());
+        TEST_ASSERT_EQUAL_UINT16(lSector, sRing.sector());
+    }
+}
+
+// a generation, which does not fit up to the end of the ring, starts at its first sector
+void test_wrap_around()
+{
+    size_t lLength = FlashUserDataRing::maxSize() - USERDATA_HEADER_SIZE - USERDATA_TRAILER_SIZE;
+    uint16_t lLast = FlashUserDataRing::sectors() - FlashUserDataRing::sectorsOf(lLength);
+    sRing.commit(1, lLast - 1, lLength);
+    TEST_ASSERT_EQUAL_UINT16(0, sRing.nextSector(lLength));
+    sRing.commit(1, lLast, lLength);
+    TEST_ASSERT_EQUAL_UINT16(0, sRing.nextSector(lLength));
+    sRing.commit(1, 0, lLength);
+    TEST_ASSERT_EQUAL_UINT16(FlashUserDataRing::sectorsOf(lLength), sRing.nextSector(lLength));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_geometry);
+    RUN_TEST(test_empty_flash);
+    RUN_TEST(test_records);
+    RUN_TEST(test_record_crc);
+    RUN_TEST(test_newest_generation);
+    RUN_TEST(test_incomplete_generation);
+    RUN_TEST(test_next_sector);
+    RUN_TEST(test_wrap_around);
+    return UNITY_END();
+}